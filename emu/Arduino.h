@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * Arduino.h is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Stand-in for the Teensy core when building the Linux host emulator.
+ * Only provides what the sources in src/ use.
+ */
+
+#ifndef EMU_ARDUINO_H_
+#define EMU_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH   1
+#define LOW    0
+#define OUTPUT 1
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define FASTRUN
+
+#define __disable_irq()
+#define __enable_irq()
+
+/* usb_serial_readline() of the core: the line did not fit and was dropped */
+#define USB_SERIAL_LINE_TOO_LONG -2
+
+class EmuSerial
+{
+public:
+    void begin(long baud) { (void)baud; }
+    int available();
+    int read();
+    void flush();
+    void endResponse() { flush(); }
+    /* the emulator writes on flush and before it waits, the timeout is only kept */
+    void setFlushTimeout(uint8_t ms) { _flushTimeout = ms; }
+    uint8_t flushTimeout() { return _flushTimeout; }
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+    size_t readBytes(char *buffer, size_t length);
+    size_t readBytes(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+    int readLine(char *buffer, size_t size);
+    /* the pty has no line state, the emulator keeps its slave side open */
+    uint8_t dtr() { return 1; }
+
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t write(uint8_t c) { return write(&c, 1); }
+
+    size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int n, int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+
+    size_t println() { return print("\r\n"); }
+    template<typename T> size_t println(T v) { return print(v) + println(); }
+    template<typename T> size_t println(T v, int base) { return print(v, base) + println(); }
+
+private:
+    unsigned long _timeout = 1000;
+    uint8_t _flushTimeout = 5;
+};
+
+extern EmuSerial Serial;
+extern uint32_t usb_serial_write_reserve(uint8_t **buffer);
+extern void usb_serial_write_commit(uint32_t size);
+
+extern uint32_t millis();
+extern uint32_t micros();
+#define F_CPU_ACTUAL F_CPU
+extern void delay(uint32_t ms);
+extern uint32_t emuCycleCount();
+extern void emuWaitForInput();
+
+static inline void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+static inline void digitalWrite(uint8_t pin, uint8_t val) { (void)pin; (void)val; }
+
+/* registers used outside of the flash programming code */
+extern uint8_t emuFSEC;
+extern uint32_t emuDEMCR, emuDWTCTRL;
+
+#define FTFL_FSEC               emuFSEC
+#define ARM_DEMCR               emuDEMCR
+#define ARM_DEMCR_TRCENA        (1 << 24)
+#define ARM_DWT_CTRL            emuDWTCTRL
+#define ARM_DWT_CTRL_CYCCNTENA  (1 << 0)
+#define ARM_DWT_CYCCNT          emuCycleCount()
+
+#include <avr/eeprom.h>
+
+extern void setup();
+extern void loop();
+
+#endif /* EMU_ARDUINO_H_ */
@@ -0,0 +1,44 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * avr/eeprom.h is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* EEPROM stand-in of the Linux host emulator, backed by a memory-mapped file */
+
+#ifndef EMU_AVR_EEPROM_H_
+#define EMU_AVR_EEPROM_H_
+
+#include <stdint.h>
+
+#define E2END 0x7FF
+
+/* same statistics as teensy3/eeprom.c keeps, cycles are emulated */
+struct eeprom_stats {
+    uint32_t count;
+    uint32_t last;
+    uint32_t min;
+    uint32_t max;
+    uint32_t bytes;
+};
+
+extern struct eeprom_stats eeprom_stats;
+
+extern void eeprom_read_block(void *buf, const void *addr, uint32_t len);
+extern void eeprom_write_block(const void *buf, void *addr, uint32_t len);
+
+#endif /* EMU_AVR_EEPROM_H_ */
@@ -0,0 +1,405 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * emu.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Linux host emulator of the Fasito firmware.
+ *
+ * The command loop is exposed on a pseudo terminal and the NVRam lives in a
+ * memory-mapped file, so host tools can talk to it like to a real token:
+ *
+ *   fasito-emu [-e <eeprom image>] [-l <pty symlink>] [-s <serial number>]
+ */
+
+#include "Arduino.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define EEPROM_SIZE (E2END + 1)
+#define TX_BUFFER_SIZE 4096
+#define TX_PACKET_SIZE 64
+
+/* how long WFI sleeps at most, in ms */
+#define WFI_TIMEOUT 10
+
+EmuSerial Serial;
+struct eeprom_stats eeprom_stats;
+
+uint8_t emuFSEC = 0xde;
+uint32_t emuDEMCR, emuDWTCTRL;
+
+static int ptyFd = -1;
+static uint8_t *eeprom;
+static uint8_t macAddressEmu[6] = { 0x04, 0xe9, 0xe5, 0x00, 0x00, 0x01 };
+
+static uint8_t rxBuffer[4096];
+static size_t rxHead, rxTail;
+static uint8_t txBuffer[TX_BUFFER_SIZE];
+static size_t txLen;
+
+static struct timespec startTime;
+
+static uint64_t elapsedNanos()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)(now.tv_sec - startTime.tv_sec) * 1000000000ULL + now.tv_nsec - startTime.tv_nsec;
+}
+
+uint32_t millis()
+{
+    return elapsedNanos() / 1000000;
+}
+
+uint32_t micros()
+{
+    return elapsedNanos() / 1000;
+}
+
+uint32_t emuCycleCount()
+{
+    return elapsedNanos() * (F_CPU / 1000000) / 1000;
+}
+
+void delay(uint32_t ms)
+{
+    Serial.flush();
+    usleep(ms * 1000);
+}
+
+/* moves whatever the pty has into the receive buffer, waits up to timeout ms */
+static void fillRx(int timeout)
+{
+    if (rxHead == rxTail)
+        rxHead = rxTail = 0;
+
+    if (rxTail == sizeof(rxBuffer))
+        return;
+
+    struct pollfd pfd = { ptyFd, POLLIN, 0 };
+    if (poll(&pfd, 1, timeout) <= 0 || !(pfd.revents & POLLIN))
+        return;
+
+    ssize_t n = ::read(ptyFd, &rxBuffer[rxTail], sizeof(rxBuffer) - rxTail);
+    if (n > 0)
+        rxTail += n;
+}
+
+void emuWaitForInput()
+{
+    Serial.flush();
+    fillRx(WFI_TIMEOUT);
+}
+
+int EmuSerial::available()
+{
+    if (rxHead == rxTail)
+        fillRx(0);
+
+    return rxTail - rxHead;
+}
+
+int EmuSerial::read()
+{
+    if (!available())
+        return -1;
+
+    return rxBuffer[rxHead++];
+}
+
+size_t EmuSerial::readBytes(char *buffer, size_t length)
+{
+    const uint32_t start = millis();
+    size_t count = 0;
+
+    while (count < length) {
+        if (rxHead == rxTail) {
+            flush();
+            fillRx(WFI_TIMEOUT);
+        }
+
+        while (count < length && rxHead < rxTail)
+            buffer[count++] = rxBuffer[rxHead++];
+
+        if (count < length && millis() - start >= _timeout)
+            break;
+    }
+
+    return count;
+}
+
+/* collects a line in buffer across calls, the caller passes the same buffer
+ * until a line is returned; too long lines are dropped like the core does */
+int EmuSerial::readLine(char *buffer, size_t size)
+{
+    static size_t len = 0;
+    static bool skip = false;
+    int c;
+
+    while ((c = read()) >= 0) {
+        if (skip) {
+            skip = c != '\r';
+            continue;
+        }
+        if (c != '\r') {
+            if (len < size - 1) {
+                buffer[len++] = c;
+                continue;
+            }
+            skip = true;
+            buffer[0] = 0;
+            len = 0;
+            return USB_SERIAL_LINE_TOO_LONG;
+        }
+        const int n = len;
+        buffer[len] = 0;
+        len = 0;
+        return n;
+    }
+
+    return -1;
+}
+
+void EmuSerial::flush()
+{
+    size_t done = 0;
+
+    while (done < txLen) {
+        ssize_t n = ::write(ptyFd, &txBuffer[done], txLen - done);
+        if (n < 0) {
+            if (errno == EAGAIN) {
+                struct pollfd pfd = { ptyFd, POLLOUT, 0 };
+                poll(&pfd, 1, WFI_TIMEOUT);
+                continue;
+            }
+            break;
+        }
+        done += n;
+    }
+
+    txLen = 0;
+}
+
+size_t EmuSerial::write(const uint8_t *buffer, size_t size)
+{
+    size_t i;
+
+    for (i = 0 ; i < size ; i++) {
+        if (txLen == sizeof(txBuffer))
+            flush();
+        txBuffer[txLen++] = buffer[i];
+    }
+
+    return size;
+}
+
+/* zero-copy transmit of teensy3/usb_serial.c, split at the USB packet size
+   like on the device */
+uint32_t usb_serial_write_reserve(uint8_t **buffer)
+{
+    if (txLen + TX_PACKET_SIZE > sizeof(txBuffer))
+        Serial.flush();
+
+    *buffer = &txBuffer[txLen];
+    return TX_PACKET_SIZE - txLen % TX_PACKET_SIZE;
+}
+
+void usb_serial_write_commit(uint32_t size)
+{
+    txLen += size;
+}
+
+size_t EmuSerial::print(unsigned long n, int base)
+{
+    char buf[8 * sizeof(long) + 1], *p = &buf[sizeof(buf) - 1];
+
+    *p = 0;
+    do {
+        const int digit = n % base;
+        *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        n /= base;
+    } while (n);
+
+    return print(p);
+}
+
+size_t EmuSerial::print(long n, int base)
+{
+    if (base == DEC && n < 0)
+        return print('-') + print((unsigned long)-n, base);
+
+    return print((unsigned long)n, base);
+}
+
+void eeprom_read_block(void *buf, const void *addr, uint32_t len)
+{
+    uint32_t offset = (uintptr_t)addr;
+
+    if (offset >= EEPROM_SIZE)
+        return;
+    if (offset + len > EEPROM_SIZE)
+        len = EEPROM_SIZE - offset;
+
+    memcpy(buf, &eeprom[offset], len);
+}
+
+void eeprom_write_block(const void *buf, void *addr, uint32_t len)
+{
+    uint32_t offset = (uintptr_t)addr, i;
+    const uint8_t *src = (const uint8_t *)buf;
+
+    if (offset >= EEPROM_SIZE)
+        return;
+    if (offset + len > EEPROM_SIZE)
+        len = EEPROM_SIZE - offset;
+
+    for (i = 0 ; i < len ; i++) {
+        if (eeprom[offset + i] == src[i])
+            continue;
+
+        eeprom[offset + i] = src[i];
+        eeprom_stats.count++;
+        eeprom_stats.bytes++;
+    }
+}
+
+void readMAC(uint8_t *mac)
+{
+    memcpy(mac, macAddressEmu, 6);
+}
+
+/* the emulator itself, left out when the firmware is linked into a host benchmark */
+#ifndef EMU_NO_MAIN
+
+static bool openEEPROM(const char *path)
+{
+    const int fd = open(path, O_RDWR | O_CREAT, 0600);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) < 0)
+        return false;
+
+    if (st.st_size < EEPROM_SIZE) {
+        /* an erased FlexRAM reads 0xff */
+        uint8_t erased[EEPROM_SIZE];
+        memset(erased, 0xff, EEPROM_SIZE);
+        if (pwrite(fd, &erased[st.st_size], EEPROM_SIZE - st.st_size, st.st_size) != EEPROM_SIZE - st.st_size)
+            return false;
+    }
+
+    eeprom = (uint8_t *)mmap(NULL, EEPROM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    return eeprom != MAP_FAILED;
+}
+
+static bool openPTY(const char *link)
+{
+    ptyFd = posix_openpt(O_RDWR | O_NOCTTY);
+    if (ptyFd < 0 || grantpt(ptyFd) < 0 || unlockpt(ptyFd) < 0)
+        return false;
+
+    const char *name = ptsname(ptyFd);
+
+    /* keep the slave side open in raw mode, so the master never sees a hangup
+     * and clients get the bytes unmodified like on the USB serial port */
+    const int slave = open(name, O_RDWR | O_NOCTTY);
+    struct termios tio;
+    if (slave < 0 || tcgetattr(slave, &tio) < 0)
+        return false;
+
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    fcntl(ptyFd, F_SETFL, fcntl(ptyFd, F_GETFL) | O_NONBLOCK);
+
+    if (link) {
+        unlink(link);
+        if (symlink(name, link) < 0)
+            return false;
+    }
+
+    printf("fasito-emu: serial port %s\n", link ? link : name);
+    fflush(stdout);
+
+    return true;
+}
+
+static bool parseSerialNumber(const char *s)
+{
+    unsigned int i, b;
+
+    if (strlen(s) != 12)
+        return false;
+
+    for (i = 0 ; i < 6 ; i++) {
+        if (sscanf(&s[i * 2], "%2x", &b) != 1)
+            return false;
+        macAddressEmu[i] = b;
+    }
+
+    return true;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: fasito-emu [-e <eeprom image>] [-l <pty symlink>] [-s <serial number: 12 hex digits>]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *eepromPath = "fasito-eeprom.img", *link = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "e:l:s:")) != -1) {
+        switch (opt) {
+        case 'e': eepromPath = optarg; break;
+        case 'l': link = optarg; break;
+        case 's': if (!parseSerialNumber(optarg)) usage(); break;
+        default: usage();
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+
+    if (!openEEPROM(eepromPath)) {
+        perror(eepromPath);
+        return 1;
+    }
+
+    if (!openPTY(link)) {
+        perror("pty");
+        return 1;
+    }
+
+    setup();
+    while (1)
+        loop();
+}
+#endif /* EMU_NO_MAIN */
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * nvramtest.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Host checks of the NVRam layout migration in src/nvram.cpp.
+ *
+ * Builds images of every known layout in memory and runs them through
+ * migrateNVRam(): a v1 image is upgraded to the current layout with all
+ * fields in place, a current image is left alone, and images with a bad
+ * cold or hot checksum or an unknown version are refused. It also counts
+ * the FlexRAM writes of LOGIN, CHGPIN and INITKEY in both layouts. Prints
+ * one line per check and exits with 1 if any failed:
+ *
+ *   make check
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "nvram.h"
+
+static int failed = 0;
+
+static void check(bool ok, const char *what)
+{
+    printf("%-60s %s\n", what, ok ? "ok" : "FAILED");
+    if (!ok)
+        failed++;
+}
+
+/* a v1 image with a distinct pattern in every field */
+static void makeV1(uint8_t *image)
+{
+    FasitoNVRamV1 *v1 = (FasitoNVRamV1 *)image;
+    int i;
+
+    memset(image, 0, NVRAM_MAX_IMAGE_SIZE);
+    v1->version = 1;
+    v1->fasitoStatus = FasitoNVRam::CONFIGURED;
+    v1->userPin.status = UserPIN::SET;
+    v1->userPin.triesLeft = 2;
+    strcpy(v1->userPin.pin, "123456");
+
+    for (i = 0 ; i < NUM_PRIVATE_KEYS ; i++) {
+        v1->privateKey[i].nodeId = 0x10000000 + i;
+        v1->privateKey[i].status = i % 3;
+        memset(v1->privateKey[i].key, 0xa0 + i, 32);
+    }
+
+    for (i = 0 ; i < NUM_ADMIN_KEYS ; i++)
+        memset(&v1->adminPublicKey[i], 0x50 + i, sizeof(secp256k1_pubkey));
+
+    v1->resetCount = 0x1234;
+    nvramUpdateChecksum(image);
+}
+
+static bool sameAsV1(const FasitoNVRam *v2)
+{
+    int i;
+
+    if (v2->version != CONFIG_VERSION || v2->fasitoStatus != FasitoNVRam::CONFIGURED)
+        return false;
+
+    if (v2->userPin.status != UserPIN::SET || v2->userPin.triesLeft != 2 || strcmp(v2->userPin.pin, "123456"))
+        return false;
+
+    for (i = 0 ; i < NUM_PRIVATE_KEYS ; i++) {
+        uint8_t key[32];
+
+        memset(key, 0xa0 + i, 32);
+        if (v2->privateKey[i].nodeId != (uint32_t)(0x10000000 + i) || v2->privateKey[i].status != i % 3 ||
+            memcmp(v2->privateKey[i].key, key, 32))
+            return false;
+    }
+
+    for (i = 0 ; i < NUM_ADMIN_KEYS ; i++) {
+        secp256k1_pubkey key;
+
+        memset(&key, 0x50 + i, sizeof(key));
+        if (memcmp(&v2->adminPublicKey[i], &key, sizeof(key)))
+            return false;
+    }
+
+    return v2->resetCount == 0x1234;
+}
+
+/* FlexRAM accesses of eeprom_write_block() in teensy3/eeprom.c: aligned words,
+ * halfwords and bytes are compared, each one that changes is one write
+ */
+typedef struct FlexRAMWrites {
+    unsigned count;
+    unsigned bytes;
+    unsigned compared;
+} FlexRAMWrites;
+
+static FlexRAMWrites flexramWrite(uint8_t *flexram, const uint8_t *image, uint32_t offset, uint32_t len)
+{
+    FlexRAMWrites w = { 0, 0, len };
+
+    while (len > 0) {
+        const uint32_t lsb = offset & 3;
+        const uint32_t n = lsb == 0 && len >= 4 ? 4 : (lsb == 0 || lsb == 2) && len >= 2 ? 2 : 1;
+
+        if (memcmp(&flexram[offset], &image[offset], n)) {
+            memcpy(&flexram[offset], &image[offset], n);
+            w.count++;
+            w.bytes += n;
+        }
+
+        offset += n;
+        len -= n;
+    }
+
+    return w;
+}
+
+enum {
+    NV_LOGIN,
+    NV_CHGPIN,
+    NV_INITKEY,
+    NUM_NV_OPS
+};
+
+static const char *nvOpNames[NUM_NV_OPS] = { "LOGIN (wrong PIN)", "CHGPIN", "INITKEY" };
+
+/* the NVRam changes of the commands, see src/commands.cpp */
+template<typename NVRam> static void changeNVRam(NVRam *nv, int op)
+{
+    switch (op) {
+    case NV_LOGIN:
+        nv->userPin.triesLeft--;
+        break;
+    case NV_CHGPIN:
+        memset(nv->userPin.pin, 0, MAX_PIN_LENGTH + 1);
+        strcpy(nv->userPin.pin, "654321");
+        break;
+    case NV_INITKEY:
+        memset(nv->privateKey[1].key, 0x3c, 32);
+        nv->privateKey[1].nodeId = 0x20000001;
+        nv->privateKey[1].status = PrivateKey::INITIALISED;
+        break;
+    }
+}
+
+/* v1 rewrites the whole image for every change */
+static FlexRAMWrites writesV1(int op)
+{
+    static uint8_t image[NVRAM_MAX_IMAGE_SIZE] __attribute__((aligned(4)));
+    static uint8_t flexram[NVRAM_MAX_IMAGE_SIZE] __attribute__((aligned(4)));
+
+    makeV1(image);
+    memcpy(flexram, image, sizeof(flexram));
+
+    changeNVRam((FasitoNVRamV1 *)image, op);
+    nvramUpdateChecksum(image);
+    return flexramWrite(flexram, image, 0, sizeof(FasitoNVRamV1));
+}
+
+/* v2 writes the hot region for PIN changes, see writeHotEEPROM() */
+static FlexRAMWrites writesV2(int op)
+{
+    static uint8_t image[NVRAM_MAX_IMAGE_SIZE] __attribute__((aligned(4)));
+    static uint8_t flexram[NVRAM_MAX_IMAGE_SIZE] __attribute__((aligned(4)));
+
+    makeV1(image);
+    migrateNVRam(image);
+    memcpy(flexram, image, sizeof(flexram));
+
+    changeNVRam((FasitoNVRam *)image, op);
+    nvramUpdateHotChecksum(image);
+    if (op != NV_INITKEY)
+        return flexramWrite(flexram, image, NVRAM_HOT_OFFSET, NVRAM_HOT_SIZE);
+
+    nvramUpdateColdChecksum(image);
+    return flexramWrite(flexram, image, 0, sizeof(FasitoNVRam));
+}
+
+int main()
+{
+    static uint8_t image[NVRAM_MAX_IMAGE_SIZE] __attribute__((aligned(4)));
+    static uint8_t current[NVRAM_MAX_IMAGE_SIZE] __attribute__((aligned(4)));
+
+    makeV1(image);
+    check(nvramImageValid(image) && nvramImageSize(image) == sizeof(FasitoNVRamV1), "v1 image is valid");
+    check(migrateNVRam(image) == NVRAM_MIGRATED, "v1 -> v2 is migrated");
+    check(nvramImageValid(image) && nvramImageSize(image) == sizeof(FasitoNVRam), "migrated image is valid");
+    check(sameAsV1((const FasitoNVRam *)image), "migrated image keeps every v1 field");
+
+    memcpy(current, image, sizeof(current));
+    check(migrateNVRam(image) == NVRAM_CURRENT, "current image is not migrated again");
+    check(!memcmp(image, current, sizeof(current)), "current image is left unchanged");
+
+    makeV1(image);
+    image[offsetof(FasitoNVRamV1, resetCount)] ^= 1;
+    check(migrateNVRam(image) == NVRAM_INVALID, "v1 image with a bad checksum is refused");
+
+    memcpy(image, current, sizeof(image));
+    image[offsetof(FasitoNVRam, privateKey[3].key[7])] ^= 1;
+    check(migrateNVRam(image) == NVRAM_INVALID, "v2 image with a bad cold checksum is refused");
+
+    memcpy(image, current, sizeof(image));
+    image[offsetof(FasitoNVRam, resetCount)] ^= 1;
+    check(migrateNVRam(image) == NVRAM_INVALID, "v2 image with a bad hot checksum is refused");
+
+    memcpy(image, current, sizeof(image));
+    ((FasitoNVRam *)image)->resetCount++;
+    nvramUpdateHotChecksum(image);
+    check(migrateNVRam(image) == NVRAM_CURRENT, "hot region update keeps the image valid");
+
+    memcpy(image, current, sizeof(image));
+    image[0] = CONFIG_VERSION + 1;
+    nvramUpdateColdChecksum(image);
+    check(nvramImageSize(image) == 0 && migrateNVRam(image) == NVRAM_INVALID, "unknown version is refused");
+
+    for (int op = 0 ; op < NUM_NV_OPS ; op++) {
+        const FlexRAMWrites v1 = writesV1(op), v2 = writesV2(op);
+        char what[100];
+
+        snprintf(what, sizeof(what), "%-17s writes/bytes/compared v1 %u/%u/%u, v2 %u/%u/%u",
+                 nvOpNames[op], v1.count, v1.bytes, v1.compared, v2.count, v2.bytes, v2.compared);
+        check(v2.count <= v1.count && v2.bytes <= v1.bytes, what);
+    }
+
+    if (failed) {
+        printf("\n%d check(s) failed\n", failed);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,394 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * parsebench.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Host micro benchmarks of the command parsing layer.
+ *
+ * Links the firmware's translation units with the emulator's Arduino layer
+ * and times getCommand(), tokenise(), parseHex(), getIndexParameter() and
+ * getHexParameter() for every shape of command line the token gets, plus the
+ * whole path from the line to the parsed arguments. Options and the JSON
+ * output follow Google Benchmark, so the usual tools can compare runs:
+ *
+ *   fasito-parsebench --benchmark_format=json --benchmark_repetitions=5
+ *
+ * tokenise() and the line benchmarks copy the line first, as tokenise()
+ * writes into it; strcpy/<shape> measures that copy alone.
+ */
+
+#include "Arduino.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include <time.h>
+#include <unistd.h>
+
+#include "fasito.h"
+#include "utils.h"
+#include "commands.h"
+#include "version.h"
+
+#define MAX_ARGS 5
+
+typedef struct Argument {
+    char kind;          /* 'i': index, 'h': hex of len bytes, 's': plain string */
+    uint8_t len;
+} Argument;
+
+typedef struct Shape {
+    const char *name;
+    const char *command;
+    uint8_t nArgs;
+    Argument args[MAX_ARGS];
+    std::string line;
+} Shape;
+
+static Shape shapes[] = {
+        {"short",   "INFO",    0, {}},
+        {"index",   "GETPBKY", 1, {{'i', 1}}},
+        {"hash",    "SCHNORR", 2, {{'i', 1}, {'h', 32}}},
+        {"nonce",   "NONCE",   3, {{'i', 1}, {'h', 32}, {'h', 32}}},
+        {"pubkey",  "ECDH",    2, {{'i', 1}, {'h', 65}}},
+        {"partsig", "PARTSIG", 4, {{'i', 1}, {'i', 2}, {'h', 32}, {'h', 64}}},
+        {"init",    "INIT",    5, {{'s', 6}, {'h', 65}, {'h', 65}, {'h', 65}, {'h', 32}}},
+};
+
+typedef struct Options {
+    bool json;
+    const char *filter;
+    const char *out;
+    double minTime;
+    unsigned repetitions;
+} Options;
+
+static Options opt = { false, NULL, NULL, 0.5, 1 };
+
+typedef struct Result {
+    std::string name;
+    uint64_t iterations;
+    double realNs;
+    double cpuNs;
+    size_t bytes;
+} Result;
+
+template <class T> static inline void doNotOptimize(const T &value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+static uint64_t now(clockid_t clock)
+{
+    struct timespec ts;
+
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static std::string hexString(size_t len, uint8_t seed)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string s;
+
+    /* every digit, so parseHex() takes all its branches */
+    for (size_t i = 0 ; i < len * 2 ; i++)
+        s += digits[(i * 7 + seed) & 0xf];
+
+    /* the uncompressed public key prefix */
+    if (len == 65)
+        s.replace(0, 2, "04");
+
+    return s;
+}
+
+static void buildLines()
+{
+    for (size_t i = 0 ; i < sizeof(shapes) / sizeof(Shape) ; i++) {
+        Shape &s = shapes[i];
+
+        s.line = s.command;
+        for (uint8_t a = 0 ; a < s.nArgs ; a++) {
+            s.line += ' ';
+            if (s.args[a].kind == 'i')
+                s.line += s.args[a].len == 2 ? "12" : "0";
+            else if (s.args[a].kind == 'h')
+                s.line += hexString(s.args[a].len, a);
+            else
+                s.line += std::string(s.args[a].len, '1');
+        }
+    }
+}
+
+/* what handleCommand() and the handlers do before the crypto starts */
+static bool parseLine(const Shape &s, char *buf)
+{
+    uint8_t nTokens = 0, index, data[65];
+
+    strcpy(buf, s.line.c_str());
+
+    const Command *c = getCommand(buf);
+    if (!c)
+        return false;
+
+    const char **tokens = tokenise(&buf[c->len], &nTokens);
+    if (nTokens != s.nArgs)
+        return false;
+
+    for (uint8_t a = 0 ; a < nTokens ; a++) {
+        if (s.args[a].kind == 'i' && !getIndexParameter(tokens[a], index, 24))
+            return false;
+        if (s.args[a].kind == 'h' && !getHexParameter(tokens[a], data, s.args[a].len))
+            return false;
+    }
+
+    doNotOptimize(data);
+    return true;
+}
+
+static Result measure(const std::string &name, size_t bytes, const std::function<void(uint64_t)> &body)
+{
+    Result r;
+    uint64_t n = 16;
+
+    r.name = name;
+    r.bytes = bytes;
+
+    /* grow the iteration count until a run takes the minimum time */
+    for (;;) {
+        const uint64_t start = now(CLOCK_MONOTONIC);
+        body(n);
+        const double elapsed = (now(CLOCK_MONOTONIC) - start) / 1e9;
+
+        if (elapsed >= opt.minTime || n >= (1ULL << 40))
+            break;
+
+        const double factor = elapsed > 0 ? opt.minTime * 1.4 / elapsed : 10;
+        n = (uint64_t)(n * std::min(10.0, std::max(2.0, factor)));
+    }
+
+    std::vector<double> real, cpu;
+    for (unsigned i = 0 ; i < opt.repetitions ; i++) {
+        const uint64_t startReal = now(CLOCK_MONOTONIC), startCpu = now(CLOCK_PROCESS_CPUTIME_ID);
+        body(n);
+        cpu.push_back((double)(now(CLOCK_PROCESS_CPUTIME_ID) - startCpu) / n);
+        real.push_back((double)(now(CLOCK_MONOTONIC) - startReal) / n);
+    }
+
+    /* the median of the repetitions */
+    std::sort(real.begin(), real.end());
+    std::sort(cpu.begin(), cpu.end());
+    r.iterations = n;
+    r.realNs = real[real.size() / 2];
+    r.cpuNs = cpu[cpu.size() / 2];
+
+    return r;
+}
+
+static bool selected(const std::string &name)
+{
+    return !opt.filter || name.find(opt.filter) != std::string::npos;
+}
+
+static std::vector<Result> runAll()
+{
+    std::vector<Result> results;
+    static char buf[INPUT_BUFFER_SIZE];
+
+    for (size_t i = 0 ; i < sizeof(shapes) / sizeof(Shape) ; i++) {
+        const Shape &s = shapes[i];
+        const char *line = s.line.c_str();
+        const size_t len = s.line.length();
+        const uint8_t cmdLen = strlen(s.command);
+
+        if (selected(std::string("strcpy/") + s.name))
+            results.push_back(measure(std::string("strcpy/") + s.name, len, [&](uint64_t n) {
+                for (uint64_t k = 0 ; k < n ; k++) {
+                    strcpy(buf, line);
+                    doNotOptimize(buf);
+                }
+            }));
+
+        if (selected(std::string("getCommand/") + s.name)) {
+            strcpy(buf, line);
+            results.push_back(measure(std::string("getCommand/") + s.name, len, [&](uint64_t n) {
+                for (uint64_t k = 0 ; k < n ; k++)
+                    doNotOptimize(getCommand(buf));
+            }));
+        }
+
+        if (s.nArgs && selected(std::string("tokenise/") + s.name))
+            results.push_back(measure(std::string("tokenise/") + s.name, len, [&](uint64_t n) {
+                uint8_t nTokens;
+                for (uint64_t k = 0 ; k < n ; k++) {
+                    strcpy(buf, line);
+                    doNotOptimize(tokenise(&buf[cmdLen], &nTokens));
+                }
+            }));
+
+        if (selected(std::string("line/") + s.name)) {
+            if (!parseLine(s, buf)) {
+                fprintf(stderr, "line/%s does not parse: %s\n", s.name, line);
+                exit(1);
+            }
+
+            results.push_back(measure(std::string("line/") + s.name, len, [&](uint64_t n) {
+                for (uint64_t k = 0 ; k < n ; k++)
+                    doNotOptimize(parseLine(s, buf));
+            }));
+        }
+    }
+
+    static const size_t hexSizes[] = { 32, 64, 65 };
+    for (size_t i = 0 ; i < sizeof(hexSizes) / sizeof(size_t) ; i++) {
+        const size_t size = hexSizes[i];
+        const std::string hex = hexString(size, 0);
+        uint8_t out[65];
+
+        if (selected("parseHex/" + std::to_string(size)))
+            results.push_back(measure("parseHex/" + std::to_string(size), hex.length(), [&](uint64_t n) {
+                for (uint64_t k = 0 ; k < n ; k++) {
+                    doNotOptimize(parseHex(out, hex.c_str(), size));
+                    doNotOptimize(out);
+                }
+            }));
+
+        if (size != 64 && selected("getHexParameter/" + std::to_string(size)))
+            results.push_back(measure("getHexParameter/" + std::to_string(size), hex.length(), [&](uint64_t n) {
+                for (uint64_t k = 0 ; k < n ; k++) {
+                    doNotOptimize(getHexParameter(hex.c_str(), out, size));
+                    doNotOptimize(out);
+                }
+            }));
+    }
+
+    static const char *indices[] = { "0", "12" };
+    for (size_t i = 0 ; i < sizeof(indices) / sizeof(char *) ; i++) {
+        const char *idx = indices[i];
+        const std::string name = std::string("getIndexParameter/") + idx;
+
+        if (selected(name))
+            results.push_back(measure(name, strlen(idx), [&](uint64_t n) {
+                uint8_t index;
+                for (uint64_t k = 0 ; k < n ; k++) {
+                    doNotOptimize(getIndexParameter(idx, index, 24));
+                    doNotOptimize(index);
+                }
+            }));
+    }
+
+    return results;
+}
+
+static void writeJSON(FILE *f, const char *executable, const std::vector<Result> &results)
+{
+    char date[32];
+    const time_t t = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", localtime(&t));
+
+    fprintf(f, "{\n  \"context\": {\n");
+    fprintf(f, "    \"date\": \"%s\",\n", date);
+    fprintf(f, "    \"executable\": \"%s\",\n", executable);
+    fprintf(f, "    \"num_cpus\": %ld,\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fprintf(f, "    \"fasito_version\": \"%s\",\n", __FASITO_VERSION__);
+    fprintf(f, "    \"repetitions\": %u,\n", opt.repetitions);
+    fprintf(f, "    \"library_build_type\": \"release\"\n  },\n  \"benchmarks\": [\n");
+
+    for (size_t i = 0 ; i < results.size() ; i++) {
+        const Result &r = results[i];
+
+        fprintf(f, "    {\n");
+        fprintf(f, "      \"name\": \"%s\",\n", r.name.c_str());
+        fprintf(f, "      \"run_name\": \"%s\",\n", r.name.c_str());
+        fprintf(f, "      \"run_type\": \"iteration\",\n");
+        fprintf(f, "      \"iterations\": %llu,\n", (unsigned long long)r.iterations);
+        fprintf(f, "      \"real_time\": %.3f,\n", r.realNs);
+        fprintf(f, "      \"cpu_time\": %.3f,\n", r.cpuNs);
+        fprintf(f, "      \"time_unit\": \"ns\",\n");
+        fprintf(f, "      \"bytes_per_second\": %.0f\n", r.realNs > 0 ? r.bytes * 1e9 / r.realNs : 0.0);
+        fprintf(f, "    }%s\n", i + 1 < results.size() ? "," : "");
+    }
+
+    fprintf(f, "  ]\n}\n");
+}
+
+static void writeConsole(FILE *f, const std::vector<Result> &results)
+{
+    fprintf(f, "%-26s %12s %12s %14s\n", "Benchmark", "Time", "CPU", "Iterations");
+    for (size_t i = 0 ; i < results.size() ; i++) {
+        const Result &r = results[i];
+        fprintf(f, "%-26s %9.1f ns %9.1f ns %14llu\n", r.name.c_str(), r.realNs, r.cpuNs, (unsigned long long)r.iterations);
+    }
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: fasito-parsebench [--benchmark_format=console|json] [--benchmark_filter=<substring>]\n"
+            "                         [--benchmark_min_time=<seconds>] [--benchmark_repetitions=<n>]\n"
+            "                         [--benchmark_out=<json file>]\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    for (int i = 1 ; i < argc ; i++) {
+        const char *a = argv[i];
+
+        if (!strcmp(a, "--benchmark_format=json"))
+            opt.json = true;
+        else if (!strcmp(a, "--benchmark_format=console"))
+            opt.json = false;
+        else if (!strncmp(a, "--benchmark_filter=", 19))
+            opt.filter = a + 19;
+        else if (!strncmp(a, "--benchmark_min_time=", 21))
+            opt.minTime = atof(a + 21);
+        else if (!strncmp(a, "--benchmark_repetitions=", 24))
+            opt.repetitions = atoi(a + 24);
+        else if (!strncmp(a, "--benchmark_out=", 16))
+            opt.out = a + 16;
+        else
+            usage();
+    }
+
+    if (opt.minTime <= 0 || !opt.repetitions)
+        usage();
+
+    buildLines();
+
+    std::vector<Result> results = runAll();
+
+    if (opt.json)
+        writeJSON(stdout, argv[0], results);
+    else
+        writeConsole(stdout, results);
+
+    if (opt.out) {
+        FILE *f = fopen(opt.out, "w");
+        if (!f) {
+            perror(opt.out);
+            return 1;
+        }
+        writeJSON(f, argv[0], results);
+        fclose(f);
+    }
+
+    return 0;
+}
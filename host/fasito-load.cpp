@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * fasito-load.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Load generator for a Fasito token or the host emulator.
+ *
+ * It replays the command mix of a CVN: a NONCE/PARTSIG round per block,
+ * periodic SCHNORR and ECDSA signatures and GETPBKY/INFO polls from
+ * monitoring. Requests are pipelined up to the in-flight limit and
+ * latencies are reported per command. Rounds either follow a fixed block
+ * rate (open loop) or, with -b 0, start whenever fewer than -c requests are
+ * outstanding (closed loop), which measures the throughput of the token:
+ *
+ *   fasito-load -d /dev/ttyACM0 -p <PIN> -b 2 -t 60
+ *   fasito-load -E ./fasito-emu -I -p 123456 -c 4 -t 10
+ *   fasito-load -d /dev/ttyACM0 -p <PIN> -b 0 -c 8 -t 10
+ */
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "serial.h"
+#include "libfasito.h"
+
+/* throwaway admin keys for -I: the points G, 2G and 3G */
+static const char *testAdminKeys[3] = {
+        "0479be667ef9dcbbac55a06295ce870b07029bfcdb2dce28d959f2815b16f81798483ada7726a3c4655da4fbfc0e1108a8fd17b448a68554199c47d08ffb10d4b8",
+        "04c6047f9441ed7d6d3045406e95c07cd85c778e4b8cef3ca7abac09b95c709ee51ae168fea63dc339a3c58419466ceaeef7f632653266d0e1236431a950cfe52a",
+        "04f9308a019258c31049344f85f89d5229b531c845836f99b08601f113bce036f9388f7b0f632de8140fe337e62a37f3566500a99934c2231b6cb9fd7584b8e672",
+};
+static const char *testDeviceKey = "0101010101010101010101010101010101010101010101010101010101010101";
+
+enum {
+    REQ_NONCE,
+    REQ_PARTSIG,
+    REQ_SCHNORR,
+    REQ_ECDSA,
+    REQ_GETPBKY,
+    REQ_INFO,
+    REQ_ROUND,          /* NONCE queued to PARTSIG done, not sent itself */
+    NUM_REQ
+};
+
+static const char *reqNames[NUM_REQ] = { "NONCE", "PARTSIG", "SCHNORR", "ECDSA", "GETPBKY", "INFO", "ROUND" };
+
+typedef struct Results {
+    std::vector<uint32_t> latency;      /* write to end of response */
+    std::vector<uint32_t> wait;         /* scheduled to write */
+    uint32_t errors;
+} Results;
+
+typedef struct Options {
+    const char *device;
+    const char *emulator;
+    const char *pin;
+    bool init;
+    unsigned keyIndex;
+    double blocksPerSecond;
+    unsigned schnorrEvery;
+    unsigned ecdsaEvery;
+    unsigned pollMs;
+    unsigned inFlight;
+    double duration;
+    unsigned long seed;
+} Options;
+
+static Options opt = { NULL, NULL, NULL, false, 0, 1.0, 10, 10, 1000, 1, 10.0, 1 };
+static std::mt19937_64 rng;
+static Results results[NUM_REQ];
+static const char *aborted = NULL;
+
+static std::string randomHex(size_t bytes)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string s;
+
+    while (bytes--) {
+        const uint8_t b = rng();
+        s += digits[b >> 4];
+        s += digits[b & 0xf];
+    }
+
+    return s;
+}
+
+static void record(uint8_t type, const FasitoResponse &r)
+{
+    Results &res = results[type];
+
+    res.latency.push_back(r.latencyUs());
+    res.wait.push_back(r.waitUs());
+    if (!r.ok)
+        res.errors++;
+
+    /* the pipeline is gone after these, there is no point in going on */
+    if (r.error == "timeout")
+        aborted = "timeout";
+    else if (r.error == "device disconnected")
+        aborted = "device disconnected";
+}
+
+static bool checked(const char *what, const FasitoResponse &r)
+{
+    if (!r.ok)
+        fprintf(stderr, "%s failed: %s\n", what, r.error.c_str());
+
+    return r.ok;
+}
+
+static bool setupToken(FasitoClient &client)
+{
+    if (opt.init) {
+        std::string adminKeys[3] = { testAdminKeys[0], testAdminKeys[1], testAdminKeys[2] };
+        FasitoFuture f = client.init(opt.pin, adminKeys, testDeviceKey);
+
+        if (!checked("INIT", client.wait(f)))
+            return false;
+    }
+
+    if (opt.pin) {
+        FasitoFuture f = client.login(opt.pin);
+
+        if (!checked("LOGIN", client.wait(f)))
+            return false;
+    }
+
+    if (opt.init) {
+        FasitoFuture f = client.initKey(opt.keyIndex, 0x12345678, randomHex(32));
+
+        if (!checked("INITKEY", client.wait(f)))
+            return false;
+    }
+
+    return true;
+}
+
+/* the NONCE response is "<slot> <public nonce>", the round continues with a PARTSIG on that slot */
+static void continueRound(FasitoClient &client, const FasitoResponse &nonce)
+{
+    unsigned slot;
+    std::string publicNonce;
+
+    if (!parseNonceResponse(nonce, &slot, &publicNonce))
+        return;
+
+    const uint64_t roundStart = nonce.queuedUs;
+
+    /* the own public nonce stands in for the sum of the other CVNs' nonces */
+    client.partSig(opt.keyIndex, slot, randomHex(32), publicNonce, [roundStart](const FasitoResponse &r) {
+        record(REQ_PARTSIG, r);
+
+        results[REQ_ROUND].latency.push_back(r.doneUs - roundStart);
+        results[REQ_ROUND].wait.push_back(0);
+        if (!r.ok)
+            results[REQ_ROUND].errors++;
+    });
+}
+
+static void scheduleBlock(FasitoClient &client, uint64_t block)
+{
+    client.nonce(opt.keyIndex, randomHex(32), randomHex(32), [&client](const FasitoResponse &r) {
+        record(REQ_NONCE, r);
+        continueRound(client, r);
+    });
+
+    if (opt.schnorrEvery && !(block % opt.schnorrEvery))
+        client.schnorr(opt.keyIndex, randomHex(32), [](const FasitoResponse &r) { record(REQ_SCHNORR, r); });
+
+    if (opt.ecdsaEvery && !(block % opt.ecdsaEvery))
+        client.ecdsa(opt.keyIndex, randomHex(32), [](const FasitoResponse &r) { record(REQ_ECDSA, r); });
+}
+
+static bool runLoad(FasitoClient &client)
+{
+    const uint64_t start = nowUs(), end = start + (uint64_t)(opt.duration * 1e6);
+    const uint64_t blockInterval = opt.blocksPerSecond ? (uint64_t)(1e6 / opt.blocksPerSecond) : 0;
+    uint64_t nextBlock = start, nextPoll = start, block = 0, polls = 0;
+
+    client.setMaxInFlight(opt.inFlight);
+
+    while (!aborted) {
+        const uint64_t now = nowUs();
+
+        if (now < end) {
+            /* closed loop: keep the pipeline at opt.inFlight requests */
+            while (!blockInterval && client.outstanding() < opt.inFlight)
+                scheduleBlock(client, block++);
+
+            for (; blockInterval && nextBlock <= now ; nextBlock += blockInterval)
+                scheduleBlock(client, block++);
+
+            for (; opt.pollMs && nextPoll <= now ; nextPoll += opt.pollMs * 1000ULL) {
+                if (polls++ & 1)
+                    client.info([](const FasitoResponse &r) { record(REQ_INFO, r); });
+                else
+                    client.getPublicKey(opt.keyIndex, [](const FasitoResponse &r) { record(REQ_GETPBKY, r); });
+            }
+        } else if (!client.outstanding()) {
+            break;
+        }
+
+        uint64_t next = opt.pollMs ? nextPoll : end;
+        if (blockInterval)
+            next = std::min(next, nextBlock);
+        const int timeout = next > now ? (int)std::min<uint64_t>((next - now) / 1000, 100) : 0;
+
+        if (!client.process(timeout))
+            aborted = "device disconnected";
+    }
+
+    if (aborted) {
+        fprintf(stderr, "aborted: %s\n", aborted);
+        return false;
+    }
+
+    const double seconds = (nowUs() - start) / 1e6;
+
+    printf("%.1f s, %llu blocks, %u in flight\n", seconds, (unsigned long long)block, opt.inFlight);
+    printf("%-8s %7s %6s %8s %9s %9s %9s %9s %11s\n", "command", "count", "errors", "req/s", "p50 us", "p90 us", "p99 us", "max us", "p99 wait us");
+
+    for (int i = 0 ; i < NUM_REQ ; i++) {
+        Results &res = results[i];
+        const size_t n = res.latency.size();
+
+        if (!n)
+            continue;
+
+        std::sort(res.latency.begin(), res.latency.end());
+        std::sort(res.wait.begin(), res.wait.end());
+
+        printf("%-8s %7zu %6u %8.1f %9u %9u %9u %9u %11u\n", reqNames[i], n, res.errors, n / seconds,
+               res.latency[n * 50 / 100], res.latency[n * 90 / 100], res.latency[n * 99 / 100], res.latency[n - 1],
+               res.wait[n * 99 / 100]);
+    }
+
+    return true;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: fasito-load (-d <serial device> | -E <fasito-emu binary>) [options]\n"
+            "  -p <PIN>        log in before the run\n"
+            "  -I              initialise the emulated token with throwaway keys (needs -E and -p)\n"
+            "  -k <index>      key slot to sign with (default: 0)\n"
+            "  -b <blocks/s>   NONCE/PARTSIG rounds per second, 0: a new round whenever\n"
+            "                  fewer than -c requests are outstanding (default: 1)\n"
+            "  -s <n>          SCHNORR every n blocks, 0: never (default: 10)\n"
+            "  -e <n>          ECDSA every n blocks, 0: never (default: 10)\n"
+            "  -m <ms>         GETPBKY/INFO monitoring poll interval, 0: never (default: 1000)\n"
+            "  -c <n>          requests in flight (default: 1)\n"
+            "  -t <seconds>    duration (default: 10)\n"
+            "  -S <seed>       seed of the random hashes (default: 1)\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int o;
+
+    while ((o = getopt(argc, argv, "d:E:p:Ik:b:s:e:m:c:t:S:")) != -1) {
+        switch (o) {
+        case 'd': opt.device = optarg; break;
+        case 'E': opt.emulator = optarg; break;
+        case 'p': opt.pin = optarg; break;
+        case 'I': opt.init = true; break;
+        case 'k': opt.keyIndex = atoi(optarg); break;
+        case 'b': opt.blocksPerSecond = atof(optarg); break;
+        case 's': opt.schnorrEvery = atoi(optarg); break;
+        case 'e': opt.ecdsaEvery = atoi(optarg); break;
+        case 'm': opt.pollMs = atoi(optarg); break;
+        case 'c': opt.inFlight = atoi(optarg); break;
+        case 't': opt.duration = atof(optarg); break;
+        case 'S': opt.seed = strtoul(optarg, NULL, 0); break;
+        default: usage();
+        }
+    }
+
+    if (!opt.device == !opt.emulator || opt.blocksPerSecond < 0 || !opt.inFlight || opt.duration <= 0)
+        usage();
+
+    /* never provision a real token with the well-known test keys */
+    if (opt.init && (!opt.emulator || !opt.pin))
+        usage();
+
+    rng.seed(opt.seed);
+
+    char port[256], image[] = "/tmp/fasito-load-XXXXXX";
+    pid_t emuPid = 0;
+
+    if (opt.emulator) {
+        int imageFd = mkstemp(image);
+        if (imageFd < 0) {
+            perror("mkstemp");
+            return 1;
+        }
+        close(imageFd);
+        unlink(image);
+
+        if (!spawnEmulator(opt.emulator, image, &emuPid, port, sizeof(port))) {
+            fprintf(stderr, "could not start %s\n", opt.emulator);
+            return 1;
+        }
+
+        opt.device = port;
+    }
+
+    FasitoClient client;
+    if (!client.open(opt.device, opt.emulator ? 2500 : 500)) {
+        perror(opt.device);
+        return 1;
+    }
+
+    bool fOK = setupToken(client) && runLoad(client);
+
+    client.close();
+
+    if (emuPid) {
+        kill(emuPid, SIGTERM);
+        waitpid(emuPid, NULL, 0);
+        unlink(image);
+    }
+
+    return fOK ? 0 : 1;
+}
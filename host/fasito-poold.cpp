@@ -0,0 +1,592 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * fasito-poold.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Signing pool daemon for several Fasito tokens provisioned with the same key slots.
+ *
+ * Clients connect to a UNIX socket and speak the token's text protocol; the
+ * daemon forwards every request to one of the tokens:
+ *
+ *  - SCHNORR, ECDSA, NONCE, GETPBKY and ECDH go to the online token with the
+ *    least outstanding work, the sum of the expected service times of its
+ *    requests in flight. Service times are learned per token and command.
+ *  - NONCE slots are reported as <token * 100 + slot>, so a PARTSIG is pinned
+ *    to the token that holds the private nonce.
+ *  - When a token disconnects or times out, its stateless requests are
+ *    retried on another token and the device is reopened periodically.
+ *    PARTSIGs for its nonces fail, the CVN has to start a new round.
+ *
+ *   fasito-poold -s /run/fasito.sock -P /etc/fasito/pin -d /dev/ttyACM0 -d /dev/ttyACM1
+ *
+ * The PIN is read from the file given with -P ("-" for stdin) or from
+ * FASITO_PIN, never from the command line where every user can see it.
+ * Devices are opened and logged in from the main loop, a token that does not
+ * answer only delays itself.
+ *
+ * POOL prints the state of the tokens.
+ */
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "serial.h"
+#include "libfasito.h"
+
+#define MAX_TOKENS              16
+#define MAX_CLIENTS             64
+#define SLOTS_PER_TOKEN         100
+#define RECONNECT_MS            2000
+#define INITIAL_ESTIMATE_US     5000
+#define MAX_LINE                512
+
+enum {
+    POOL_SCHNORR,
+    POOL_ECDSA,
+    POOL_NONCE,
+    POOL_PARTSIG,
+    POOL_GETPBKY,
+    POOL_ECDH,
+    NUM_POOL_CMDS
+};
+
+static const char *poolCommands[NUM_POOL_CMDS] = { "SCHNORR", "ECDSA", "NONCE", "PARTSIG", "GETPBKY", "ECDH" };
+
+typedef struct Token {
+    const char *path;
+    FasitoClient *client;
+    bool online;
+    bool connecting;                    /* LOGIN in flight */
+    bool failed;
+    uint64_t retryAt;
+    uint64_t outstandingUs;             /* expected work in flight */
+    uint64_t lastDone;
+    uint32_t estimateUs[NUM_POOL_CMDS]; /* moving average of the service time */
+    uint32_t inFlight;
+    uint32_t completed;
+    uint32_t errors;
+    uint32_t failovers;
+} Token;
+
+typedef struct Reply {
+    bool done;
+    std::string text;
+} Reply;
+
+typedef struct Client {
+    int fd;
+    std::string rx;
+    std::deque<std::shared_ptr<Reply> > replies;   /* in request order */
+} Client;
+
+typedef struct PoolRequest {
+    uint8_t type;
+    std::string line;
+    std::string command;
+    std::vector<std::string> args;
+    std::shared_ptr<Reply> reply;
+    unsigned attempts;
+} PoolRequest;
+
+static Token tokens[MAX_TOKENS];
+static unsigned numTokens;
+static Client clients[MAX_CLIENTS];
+static std::string pin;
+static volatile sig_atomic_t quit;
+
+static void dispatch(PoolRequest &req);
+
+static void replyError(const std::shared_ptr<Reply> &reply, const std::string &error)
+{
+    reply->text = "ERROR " + error + "\r\n";
+    reply->done = true;
+}
+
+static bool isLinkError(const std::string &error)
+{
+    return error == "device disconnected" || error == "timeout" || error == "write failed" ||
+           error == "connection closed" || error == "not connected";
+}
+
+static void takeOffline(Token &t)
+{
+    if (!t.online && !t.connecting)
+        return;
+
+    if (t.online)
+        fprintf(stderr, "%s: offline\n", t.path);
+    t.online = false;
+    t.connecting = false;
+    t.failed = true;
+    t.retryAt = nowUs() + RECONNECT_MS * 1000ULL;
+}
+
+static void loginDone(Token &t, const FasitoResponse &r)
+{
+    t.connecting = false;
+
+    if (!r.ok) {
+        fprintf(stderr, "%s: LOGIN failed: %s\n", t.path, r.error.c_str());
+        t.failed = true;
+        t.retryAt = nowUs() + RECONNECT_MS * 1000ULL;
+        return;
+    }
+
+    t.online = true;
+    t.outstandingUs = 0;
+    t.inFlight = 0;
+    t.lastDone = 0;
+    fprintf(stderr, "%s: online\n", t.path);
+}
+
+/* opens the device and queues the LOGIN, the main loop completes it */
+static bool bringOnline(Token &t)
+{
+    t.failed = false;
+    t.retryAt = nowUs() + RECONNECT_MS * 1000ULL;
+
+    if (!t.client->open(t.path, -1))
+        return false;
+
+    Token *token = &t;
+    t.connecting = true;
+    t.client->login(pin, [token](const FasitoResponse &r) { loginDone(*token, r); });
+
+    return true;
+}
+
+/* least outstanding work, ties go to the token with fewer requests in flight */
+static Token *pickToken()
+{
+    Token *best = NULL;
+
+    for (unsigned i = 0 ; i < numTokens ; i++) {
+        Token &t = tokens[i];
+
+        if (!t.online)
+            continue;
+
+        if (!best || t.outstandingUs < best->outstandingUs ||
+            (t.outstandingUs == best->outstandingUs && t.inFlight < best->inFlight))
+            best = &t;
+    }
+
+    return best;
+}
+
+/* rewrites "<slot> <public nonce>" to the pool wide slot */
+static std::string rewriteNonce(const FasitoResponse &r, unsigned tokenIndex)
+{
+    unsigned slot;
+    std::string publicNonce;
+    char line[160];
+
+    if (!parseNonceResponse(r, &slot, &publicNonce))
+        return r.raw;
+
+    snprintf(line, sizeof(line), "%02u %s\r\n", tokenIndex * SLOTS_PER_TOKEN + slot, publicNonce.c_str());
+    return std::string(line) + r.raw.substr(r.lineLength(0) + 2);
+}
+
+static void completed(unsigned tokenIndex, PoolRequest req, uint32_t estimate, const FasitoResponse &r)
+{
+    Token &t = tokens[tokenIndex];
+
+    t.inFlight--;
+    t.outstandingUs -= std::min<uint64_t>(t.outstandingUs, estimate);
+
+    if (isLinkError(r.error)) {
+        takeOffline(t);
+
+        if (req.type != POOL_PARTSIG && ++req.attempts < numTokens) {
+            t.failovers++;
+            dispatch(req);
+            return;
+        }
+
+        replyError(req.reply, "token " + std::string(t.path) + " " + r.error);
+        return;
+    }
+
+    /* service time without the wait behind earlier requests on this token */
+    const uint64_t begin = std::max(r.sentUs, t.lastDone);
+    const uint32_t service = r.doneUs > begin ? r.doneUs - begin : 0;
+    t.estimateUs[req.type] = (t.estimateUs[req.type] * 7 + service) / 8;
+    t.lastDone = r.doneUs;
+
+    t.completed++;
+    if (!r.ok)
+        t.errors++;
+
+    req.reply->text = req.type == POOL_NONCE && r.ok ? rewriteNonce(r, tokenIndex) : r.raw;
+    req.reply->done = true;
+}
+
+static void dispatch(PoolRequest &req)
+{
+    Token *t;
+    std::string line = req.line;
+
+    if (req.type == POOL_PARTSIG) {
+        /* PARTSIG <key index> <pool slot> <hash> <nonces> */
+        const unsigned slot = req.args.size() == 4 ? strtoul(req.args[1].c_str(), NULL, 10) : SLOTS_PER_TOKEN * MAX_TOKENS;
+        const unsigned tokenIndex = slot / SLOTS_PER_TOKEN;
+
+        if (tokenIndex >= numTokens) {
+            replyError(req.reply, "Invalid argument");
+            return;
+        }
+
+        t = &tokens[tokenIndex];
+        if (!t->online) {
+            replyError(req.reply, "nonce slot lost, token " + std::string(t->path) + " offline");
+            return;
+        }
+
+        char s[8];
+        snprintf(s, sizeof(s), "%02u", slot % SLOTS_PER_TOKEN);
+        line = req.command + " " + req.args[0] + " " + s + " " + req.args[2] + " " + req.args[3];
+    } else if (!(t = pickToken())) {
+        replyError(req.reply, "no token available");
+        return;
+    }
+
+    const unsigned tokenIndex = t - tokens;
+    const uint32_t estimate = t->estimateUs[req.type];
+
+    t->inFlight++;
+    t->outstandingUs += estimate;
+
+    PoolRequest copy = req;
+    t->client->call(line, [tokenIndex, copy, estimate](const FasitoResponse &r) {
+        completed(tokenIndex, copy, estimate, r);
+    });
+}
+
+static void printPool(std::string &out)
+{
+    char line[256];
+
+    for (unsigned i = 0 ; i < numTokens ; i++) {
+        const Token &t = tokens[i];
+
+        snprintf(line, sizeof(line), "%u %s: %s, in flight %u, outstanding %llu us, completed %u, errors %u, failovers %u\r\n",
+                 i, t.path, t.online ? "online" : "offline", t.inFlight, (unsigned long long)t.outstandingUs,
+                 t.completed, t.errors, t.failovers);
+        out += line;
+
+        out += "  service us:";
+        for (int c = 0 ; c < NUM_POOL_CMDS ; c++) {
+            snprintf(line, sizeof(line), " %s %u", poolCommands[c], t.estimateUs[c]);
+            out += line;
+        }
+        out += "\r\n";
+    }
+
+    out += "OK\r\n";
+}
+
+static void handleLine(Client &c, const std::string &line)
+{
+    std::shared_ptr<Reply> reply = std::make_shared<Reply>();
+    PoolRequest req;
+    size_t pos = 0;
+
+    reply->done = false;
+    c.replies.push_back(reply);
+
+    while (pos < line.size()) {
+        size_t end = line.find(' ', pos);
+        if (end == std::string::npos)
+            end = line.size();
+
+        if (end > pos) {
+            if (req.command.empty())
+                req.command = line.substr(pos, end - pos);
+            else
+                req.args.push_back(line.substr(pos, end - pos));
+        }
+
+        pos = end + 1;
+    }
+
+    if (req.command == "POOL") {
+        printPool(reply->text);
+        reply->done = true;
+        return;
+    }
+
+    for (req.type = 0 ; req.type < NUM_POOL_CMDS ; req.type++)
+        if (req.command == poolCommands[req.type])
+            break;
+
+    if (req.type == NUM_POOL_CMDS) {
+        replyError(reply, "command not supported by the pool");
+        return;
+    }
+
+    req.line = line;
+    req.reply = reply;
+    req.attempts = 0;
+    dispatch(req);
+}
+
+static void closeClient(Client &c)
+{
+    close(c.fd);
+    c.fd = -1;
+    c.rx.clear();
+    c.replies.clear();
+}
+
+static void serviceClient(Client &c)
+{
+    char buf[4096];
+    ssize_t n = read(c.fd, buf, sizeof(buf));
+
+    if (n <= 0) {
+        if (n == 0 || (errno != EAGAIN && errno != EINTR))
+            closeClient(c);
+        return;
+    }
+
+    c.rx.append(buf, n);
+
+    size_t start = 0, i;
+    for (i = 0 ; i < c.rx.size() ; i++) {
+        if (c.rx[i] != '\r' && c.rx[i] != '\n')
+            continue;
+
+        if (i > start)
+            handleLine(c, c.rx.substr(start, i - start));
+        start = i + 1;
+    }
+
+    c.rx.erase(0, start);
+
+    if (c.rx.size() > MAX_LINE)
+        closeClient(c);
+}
+
+/* sends the finished replies of each client in request order */
+static void flushReplies()
+{
+    for (int i = 0 ; i < MAX_CLIENTS ; i++) {
+        Client &c = clients[i];
+        std::string out;
+
+        while (c.fd >= 0 && !c.replies.empty() && c.replies.front()->done) {
+            out += c.replies.front()->text;
+            c.replies.pop_front();
+        }
+
+        if (!out.empty() && !writeSerial(c.fd, out.data(), out.size()))
+            closeClient(c);
+    }
+}
+
+static int openSocket(const char *path)
+{
+    struct sockaddr_un addr;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0 || strlen(path) >= sizeof(addr.sun_path))
+        return -1;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    unlink(path);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, 8) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void acceptClient(int listenFd)
+{
+    int fd = accept(listenFd, NULL, NULL);
+
+    if (fd < 0)
+        return;
+
+    for (int i = 0 ; i < MAX_CLIENTS ; i++) {
+        if (clients[i].fd < 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            clients[i].fd = fd;
+            return;
+        }
+    }
+
+    close(fd);
+}
+
+static void onSignal(int sig)
+{
+    (void)sig;
+    quit = 1;
+}
+
+static void usage()
+{
+    fprintf(stderr, "usage: fasito-poold -s <socket> [-P <PIN file>] [-c <requests in flight per token>] -d <serial device> [-d <serial device> ...]\n");
+    fprintf(stderr, "       the PIN is read from the first line of <PIN file>, of stdin for \"-\", or from FASITO_PIN\n");
+    exit(1);
+}
+
+static bool readPin(const char *path)
+{
+    if (!path) {
+        const char *env = getenv("FASITO_PIN");
+        if (!env)
+            return false;
+        pin = env;
+        return !pin.empty();
+    }
+
+    FILE *f = strcmp(path, "-") ? fopen(path, "r") : stdin;
+    if (!f) {
+        perror(path);
+        return false;
+    }
+
+    char line[64];
+    bool ok = fgets(line, sizeof(line), f) != NULL;
+    if (f != stdin)
+        fclose(f);
+
+    if (ok) {
+        line[strcspn(line, "\r\n")] = 0;
+        pin = line;
+    }
+    memset(line, 0, sizeof(line));
+
+    return !pin.empty();
+}
+
+int main(int argc, char **argv)
+{
+    const char *socketPath = NULL;
+    const char *pinPath = NULL;
+    unsigned inFlight = FASITO_DEFAULT_IN_FLIGHT;
+    int o;
+
+    while ((o = getopt(argc, argv, "s:P:c:d:")) != -1) {
+        switch (o) {
+        case 's': socketPath = optarg; break;
+        case 'P': pinPath = optarg; break;
+        case 'c': inFlight = atoi(optarg); break;
+        case 'd':
+            if (numTokens == MAX_TOKENS)
+                usage();
+            tokens[numTokens++].path = optarg;
+            break;
+        default: usage();
+        }
+    }
+
+    if (!socketPath || !numTokens || !readPin(pinPath))
+        usage();
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    for (int i = 0 ; i < MAX_CLIENTS ; i++)
+        clients[i].fd = -1;
+
+    for (unsigned i = 0 ; i < numTokens ; i++) {
+        Token &t = tokens[i];
+
+        t.client = new FasitoClient(inFlight);
+        for (int c = 0 ; c < NUM_POOL_CMDS ; c++)
+            t.estimateUs[c] = INITIAL_ESTIMATE_US;
+
+        if (!bringOnline(t))
+            fprintf(stderr, "%s: not available, retrying\n", t.path);
+    }
+
+    int listenFd = openSocket(socketPath);
+    if (listenFd < 0) {
+        perror(socketPath);
+        return 1;
+    }
+
+    while (!quit) {
+        struct pollfd p[1 + MAX_CLIENTS + MAX_TOKENS];
+        unsigned n = 0, i;
+
+        p[n++] = (struct pollfd){ listenFd, POLLIN, 0 };
+        for (i = 0 ; i < MAX_CLIENTS ; i++)
+            if (clients[i].fd >= 0)
+                p[n++] = (struct pollfd){ clients[i].fd, POLLIN, 0 };
+        for (i = 0 ; i < numTokens ; i++)
+            if (tokens[i].online || tokens[i].connecting)
+                p[n++] = (struct pollfd){ tokens[i].client->fileDescriptor(), POLLIN, 0 };
+
+        poll(p, n, 10);
+
+        if (p[0].revents & POLLIN)
+            acceptClient(listenFd);
+
+        for (i = 0 ; i < MAX_CLIENTS ; i++)
+            if (clients[i].fd >= 0)
+                serviceClient(clients[i]);
+
+        const uint64_t now = nowUs();
+        for (i = 0 ; i < numTokens ; i++) {
+            Token &t = tokens[i];
+
+            if ((t.online || t.connecting) && !t.client->process(0))
+                takeOffline(t);
+
+            if (t.failed && t.online == false && t.client->isOpen())
+                t.client->close();
+
+            if (!t.online && !t.connecting && now >= t.retryAt)
+                bringOnline(t);
+        }
+
+        flushReplies();
+    }
+
+    for (unsigned i = 0 ; i < numTokens ; i++)
+        delete tokens[i].client;
+
+    close(listenFd);
+    unlink(socketPath);
+
+    return 0;
+}
@@ -0,0 +1,703 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * fasito-provision.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Provisioning tool for a batch of Fasito tokens.
+ *
+ * It replaces handling/createInitKeys.sh: the keys are generated with
+ * libsecp256k1 in-process and every token is provisioned by its own worker:
+ *
+ *  1. INIT with the PIN, the three admin public keys and a fresh device key
+ *  2. LOGIN and INFO for the serial number
+ *  3. INITKEY with a fresh seed for every requested slot
+ *  4. KYPROOF for every slot. The proof is verified against the device public
+ *     key and the public key derived on the host from the device key and seed.
+ *
+ * Device keys and seeds are wiped when a token is done, together with the hex
+ * copies libfasito keeps of the INIT and INITKEY lines until they are sent.
+ * The manifest only gets the PINs, public keys and key proofs:
+ *
+ *   fasito-provision -a admin.keys -k 0:0x10000000 -o batch.json -d /dev/ttyACM0 -d /dev/ttyACM1
+ *
+ * Token n of the batch (in -d order) gets node ID 0x10000000 + n on slot 0. The
+ * admin key file is created if it does not exist; without devices that is all
+ * the tool does.
+ */
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "secp256k1.h"
+#include "secp256k1_schnorr.h"
+
+#include "serial.h"
+#include "libfasito.h"
+
+/* see src/fasito.h, the last slot holds the device key */
+#define NUM_PRIVATE_KEYS        8
+#define NUM_ADMIN_KEYS          3
+#define MAX_EMULATORS           64
+
+/* see hasEnoughBits() in src/commands.cpp */
+#define ENOUGH_BITS_VALUE       800
+
+typedef struct SlotSpec {
+    unsigned index;
+    uint32_t firstNodeId;
+} SlotSpec;
+
+typedef struct KeyResult {
+    unsigned index;
+    uint32_t nodeId;
+    std::string pubKey;
+    std::string compressedPubKey;
+    std::string proofData;
+    std::string hash;
+    std::string signature;
+} KeyResult;
+
+typedef struct TokenResult {
+    std::string device;
+    std::string serialNumber;
+    std::string pin;
+    std::string devicePubKey;
+    std::vector<KeyResult> keys;
+    std::string error;
+    double seconds;
+} TokenResult;
+
+typedef struct Options {
+    std::vector<const char *> devices;
+    const char *emulator;
+    unsigned numEmulators;
+    const char *adminKeyFile;
+    const char *manifest;
+    const char *pin;
+    std::vector<SlotSpec> slots;
+} Options;
+
+static Options opt = { std::vector<const char *>(), NULL, 1, NULL, NULL, NULL, std::vector<SlotSpec>() };
+static secp256k1_context *ctx;
+static std::string adminKeys[NUM_ADMIN_KEYS];
+static std::mutex outputMutex;
+
+static void wipe(void *p, size_t len)
+{
+    volatile uint8_t *v = (volatile uint8_t *)p;
+
+    while (len--)
+        *v++ = 0;
+}
+
+static bool randomBytes(uint8_t *buf, size_t len)
+{
+    FILE *f = fopen("/dev/urandom", "rb");
+    if (!f)
+        return false;
+
+    const bool fOK = fread(buf, 1, len, f) == len;
+
+    fclose(f);
+    return fOK;
+}
+
+static std::string toHex(const uint8_t *data, size_t len)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string s;
+
+    s.reserve(len * 2);
+    while (len--) {
+        s += digits[*data >> 4];
+        s += digits[*data++ & 0xf];
+    }
+
+    return s;
+}
+
+static bool fromHex(const std::string &s, uint8_t *data, size_t len)
+{
+    if (s.length() != len * 2)
+        return false;
+
+    for (size_t i = 0 ; i < len ; i++) {
+        unsigned v;
+        if (!isxdigit((unsigned char)s[i * 2]) || !isxdigit((unsigned char)s[i * 2 + 1]) || sscanf(&s[i * 2], "%2x", &v) != 1)
+            return false;
+        data[i] = v;
+    }
+
+    return true;
+}
+
+/* a valid private key that the token also accepts as INITKEY seed */
+static bool generatePrivateKey(uint8_t *key)
+{
+    for (;;) {
+        if (!randomBytes(key, 32))
+            return false;
+
+        uint32_t sum = 0, nZeroCount = 0;
+        for (int i = 0 ; i < 32 ; i++) {
+            sum += key[i];
+            if (!key[i])
+                nZeroCount++;
+        }
+
+        if (sum > ENOUGH_BITS_VALUE && nZeroCount < 5 && secp256k1_ec_seckey_verify(ctx, key))
+            return true;
+    }
+}
+
+static std::string serializePublicKey(const secp256k1_pubkey &pub, bool compressed)
+{
+    uint8_t der[65];
+    size_t len = sizeof(der);
+
+    if (!secp256k1_ec_pubkey_serialize(ctx, der, &len, &pub, compressed ? SECP256K1_EC_COMPRESSED : SECP256K1_EC_UNCOMPRESSED))
+        return std::string();
+
+    return toHex(der, len);
+}
+
+static bool randomPin(std::string *pin)
+{
+    /* 6 digits without modulo bias */
+    const uint32_t limit = UINT32_MAX - UINT32_MAX % 900000;
+    uint32_t v;
+
+    do {
+        if (!randomBytes((uint8_t *)&v, sizeof(v)))
+            return false;
+    } while (v >= limit);
+
+    char buf[8];
+    snprintf(buf, sizeof(buf), "%06u", (unsigned)(100000 + v % 900000));
+    *pin = buf;
+    return true;
+}
+
+/* admin key file: one "<private key> <public key>" per line, the private keys may be removed */
+static bool createAdminKeyFile(const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        perror(path);
+        return false;
+    }
+
+    FILE *f = fdopen(fd, "w");
+    fprintf(f, "# Fasito admin keys: <private key> <public key>\n"
+               "# keep the private keys offline, provisioning only needs the public keys\n");
+
+    for (int i = 0 ; i < NUM_ADMIN_KEYS ; i++) {
+        uint8_t key[32];
+        secp256k1_pubkey pub;
+
+        if (!generatePrivateKey(key) || !secp256k1_ec_pubkey_create(ctx, &pub, key)) {
+            fprintf(stderr, "could not create admin key\n");
+            fclose(f);
+            unlink(path);
+            return false;
+        }
+
+        adminKeys[i] = serializePublicKey(pub, false);
+        fprintf(f, "%s %s\n", toHex(key, 32).c_str(), adminKeys[i].c_str());
+        wipe(key, sizeof(key));
+    }
+
+    if (fclose(f)) {
+        perror(path);
+        return false;
+    }
+
+    fprintf(stderr, "created admin keys in %s\n", path);
+    return true;
+}
+
+static bool readAdminKeyFile(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+
+    char line[512];
+    int n = 0;
+
+    while (fgets(line, sizeof(line), f)) {
+        char *last = NULL;
+        for (char *t = strtok(line, " \t\r\n"); t ; t = strtok(NULL, " \t\r\n")) {
+            if (*t == '#')
+                break;
+            last = t;
+        }
+
+        if (!last)
+            continue;
+
+        uint8_t der[65];
+        secp256k1_pubkey pub;
+
+        if (n == NUM_ADMIN_KEYS || !fromHex(last, der, sizeof(der)) || !secp256k1_ec_pubkey_parse(ctx, &pub, der, sizeof(der))) {
+            fprintf(stderr, "%s: invalid admin public key %s\n", path, last);
+            fclose(f);
+            return false;
+        }
+
+        adminKeys[n++] = last;
+    }
+
+    fclose(f);
+
+    if (n != NUM_ADMIN_KEYS) {
+        fprintf(stderr, "%s: %d admin public keys instead of %d\n", path, n, NUM_ADMIN_KEYS);
+        return false;
+    }
+
+    return true;
+}
+
+/* splits the KEYPROOF block into its "key": "value" pairs */
+static std::map<std::string, std::string> parseKeyProof(const FasitoResponse &r)
+{
+    std::map<std::string, std::string> proof;
+
+    for (size_t i = 0 ; i < r.lineCount() ; i++) {
+        const std::string l = r.line(i);
+        size_t q[4], pos = 0;
+        int n;
+
+        for (n = 0 ; n < 4 ; n++) {
+            if ((q[n] = l.find('"', pos)) == std::string::npos)
+                break;
+            pos = q[n] + 1;
+        }
+
+        if (n == 4)
+            proof[l.substr(q[0] + 1, q[1] - q[0] - 1)] = l.substr(q[2] + 1, q[3] - q[2] - 1);
+    }
+
+    return proof;
+}
+
+/* checks a key proof against the node ID, the key derived on the host and the device public key */
+static bool verifyKeyProof(const FasitoResponse &r, const secp256k1_pubkey &devicePub, const uint8_t *userKey, KeyResult &k, std::string *error)
+{
+    std::map<std::string, std::string> proof = parseKeyProof(r);
+    uint8_t data[68], raw[64], der[65], hash[32], sig[64];
+
+    if (!fromHex(proof["proofData"], data, sizeof(data)) || !fromHex(proof["rawPubKey"], raw, sizeof(raw))
+            || !fromHex(proof["derPubKey"], der, sizeof(der)) || !fromHex(proof["hash"], hash, sizeof(hash))
+            || !fromHex(proof["signature"], sig, sizeof(sig))) {
+        *error = "malformed key proof";
+        return false;
+    }
+
+    const uint8_t nodeId[4] = { (uint8_t)(k.nodeId >> 24), (uint8_t)(k.nodeId >> 16), (uint8_t)(k.nodeId >> 8), (uint8_t)k.nodeId };
+    if (memcmp(data, nodeId, 4) || memcmp(&data[4], raw, 64)) {
+        *error = "key proof data does not match the node ID or key";
+        return false;
+    }
+
+    secp256k1_pubkey pub, expected;
+    if (!secp256k1_ec_pubkey_parse(ctx, &pub, der, sizeof(der)) || memcmp(pub.data, raw, 64)) {
+        *error = "invalid public key in key proof";
+        return false;
+    }
+
+    if (!secp256k1_ec_pubkey_create(ctx, &expected, userKey) || memcmp(expected.data, pub.data, sizeof(pub.data))) {
+        *error = "public key differs from the key derived on the host";
+        return false;
+    }
+
+    uint8_t check[32];
+    if (!secp256k1_hash_sha256d(ctx, check, data, sizeof(data)) || memcmp(check, hash, 32)) {
+        *error = "key proof hash mismatch";
+        return false;
+    }
+
+    if (!secp256k1_schnorr_verify(ctx, sig, hash, &devicePub)) {
+        *error = "invalid device signature on key proof";
+        return false;
+    }
+
+    k.pubKey = serializePublicKey(pub, false);
+    k.compressedPubKey = serializePublicKey(pub, true);
+    k.proofData = proof["proofData"];
+    k.hash = proof["hash"];
+    k.signature = proof["signature"];
+    return true;
+}
+
+static bool step(FasitoClient &client, FasitoFuture &f, const char *what, FasitoResponse *r, TokenResult &t)
+{
+    *r = client.wait(f);
+
+    if (!r->ok)
+        t.error = std::string(what) + ": " + r->error;
+
+    return r->ok;
+}
+
+static bool provision(FasitoClient &client, TokenResult &t, unsigned position, uint8_t *deviceKey, uint8_t (*userKeys)[32])
+{
+    FasitoResponse r;
+    secp256k1_pubkey devicePub;
+
+    if (!generatePrivateKey(deviceKey) || !secp256k1_ec_pubkey_create(ctx, &devicePub, deviceKey)) {
+        t.error = "could not create device key";
+        return false;
+    }
+
+    t.devicePubKey = serializePublicKey(devicePub, false);
+
+    if (opt.pin)
+        t.pin = opt.pin;
+    else if (!randomPin(&t.pin)) {
+        t.error = "could not create PIN";
+        return false;
+    }
+
+    std::string deviceKeyHex = toHex(deviceKey, 32);
+    FasitoFuture f = client.init(t.pin, adminKeys, deviceKeyHex);
+    wipe(&deviceKeyHex[0], deviceKeyHex.length());
+
+    if (!step(client, f, "INIT", &r, t))
+        return false;
+
+    f = client.login(t.pin);
+    if (!step(client, f, "LOGIN", &r, t))
+        return false;
+
+    f = client.info();
+    if (!step(client, f, "INFO", &r, t))
+        return false;
+
+    for (size_t i = 0 ; i < r.lineCount() ; i++) {
+        const std::string l = r.line(i);
+        if (!l.compare(0, 13, "Serial number") && l.find(": ") != std::string::npos)
+            t.serialNumber = l.substr(l.find(": ") + 2);
+    }
+
+    for (size_t i = 0 ; i < opt.slots.size() ; i++) {
+        KeyResult k;
+        uint8_t seed[32], data[64];
+
+        k.index = opt.slots[i].index;
+        k.nodeId = opt.slots[i].firstNodeId + position;
+
+        if (!generatePrivateKey(seed)) {
+            t.error = "could not create seed";
+            return false;
+        }
+
+        /* the token derives the key as sha256(device key | seed), see cmdInitKey() */
+        memcpy(data, deviceKey, 32);
+        memcpy(&data[32], seed, 32);
+        const bool fDerived = secp256k1_hash_sha256(ctx, userKeys[i], data, sizeof(data));
+        wipe(data, sizeof(data));
+
+        std::string seedHex = toHex(seed, 32);
+        wipe(seed, sizeof(seed));
+
+        if (!fDerived) {
+            t.error = "could not derive key";
+            return false;
+        }
+
+        f = client.initKey(k.index, k.nodeId, seedHex);
+        wipe(&seedHex[0], seedHex.length());
+
+        if (!step(client, f, "INITKEY", &r, t))
+            return false;
+
+        f = client.keyProof(k.index);
+        if (!step(client, f, "KYPROOF", &r, t))
+            return false;
+
+        std::string error;
+        if (!verifyKeyProof(r, devicePub, userKeys[i], k, &error)) {
+            t.error = "KYPROOF " + std::to_string(k.index) + ": " + error;
+            return false;
+        }
+
+        t.keys.push_back(k);
+    }
+
+    f = client.logout();
+    return step(client, f, "LOGOUT", &r, t);
+}
+
+static void worker(TokenResult *t, unsigned position)
+{
+    const uint64_t start = nowUs();
+    FasitoClient client;
+
+    if (!client.open(t->device.c_str(), opt.emulator ? 2500 : 500)) {
+        t->error = std::string("open: ") + strerror(errno);
+    } else {
+        uint8_t deviceKey[32], userKeys[NUM_PRIVATE_KEYS][32];
+
+        provision(client, *t, position, deviceKey, userKeys);
+
+        wipe(deviceKey, sizeof(deviceKey));
+        wipe(userKeys, sizeof(userKeys));
+        client.close();
+    }
+
+    t->seconds = (nowUs() - start) / 1e6;
+
+    std::lock_guard<std::mutex> lock(outputMutex);
+    if (t->error.empty())
+        fprintf(stderr, "%s: %s provisioned, %u key(s) verified\n", t->device.c_str(), t->serialNumber.c_str(), (unsigned)t->keys.size());
+    else
+        fprintf(stderr, "%s: FAILED, %s\n", t->device.c_str(), t->error.c_str());
+}
+
+static std::string jsonString(const std::string &s)
+{
+    std::string out = "\"";
+
+    for (size_t i = 0 ; i < s.length() ; i++) {
+        const unsigned char c = s[i];
+
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else
+            out += c;
+    }
+
+    return out + "\"";
+}
+
+/* the manifest holds the PINs, it is only readable by the owner */
+static bool writeManifest(const char *path, const std::vector<TokenResult> &tokens)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    FILE *f = fd < 0 ? NULL : fdopen(fd, "w");
+
+    if (!f) {
+        perror(path);
+        return false;
+    }
+
+    fprintf(f, "{\n  \"adminPubKeys\": [\n");
+    for (int i = 0 ; i < NUM_ADMIN_KEYS ; i++)
+        fprintf(f, "    %s%s\n", jsonString(adminKeys[i]).c_str(), i + 1 < NUM_ADMIN_KEYS ? "," : "");
+    fprintf(f, "  ],\n  \"tokens\": [\n");
+
+    for (size_t n = 0 ; n < tokens.size() ; n++) {
+        const TokenResult &t = tokens[n];
+
+        fprintf(f, "    {\n      \"device\": %s,\n", jsonString(t.device).c_str());
+        fprintf(f, "      \"status\": %s,\n", t.error.empty() ? "\"provisioned\"" : "\"failed\"");
+        if (!t.error.empty())
+            fprintf(f, "      \"error\": %s,\n", jsonString(t.error).c_str());
+        fprintf(f, "      \"serialNumber\": %s,\n", jsonString(t.serialNumber).c_str());
+        fprintf(f, "      \"pin\": %s,\n", jsonString(t.pin).c_str());
+        fprintf(f, "      \"devicePubKey\": %s,\n", jsonString(t.devicePubKey).c_str());
+        fprintf(f, "      \"seconds\": %.3f,\n", t.seconds);
+        fprintf(f, "      \"keys\": [\n");
+
+        for (size_t i = 0 ; i < t.keys.size() ; i++) {
+            const KeyResult &k = t.keys[i];
+
+            fprintf(f, "        {\n");
+            fprintf(f, "          \"index\": %u,\n", k.index);
+            fprintf(f, "          \"nodeId\": \"0x%08x\",\n", k.nodeId);
+            fprintf(f, "          \"pubKey\": \"%s\",\n", k.pubKey.c_str());
+            fprintf(f, "          \"compressedPubKey\": \"%s\",\n", k.compressedPubKey.c_str());
+            fprintf(f, "          \"proofData\": \"%s\",\n", k.proofData.c_str());
+            fprintf(f, "          \"hash\": \"%s\",\n", k.hash.c_str());
+            fprintf(f, "          \"signature\": \"%s\"\n", k.signature.c_str());
+            fprintf(f, "        }%s\n", i + 1 < t.keys.size() ? "," : "");
+        }
+
+        fprintf(f, "      ]\n    }%s\n", n + 1 < tokens.size() ? "," : "");
+    }
+
+    fprintf(f, "  ]\n}\n");
+
+    if (fclose(f)) {
+        perror(path);
+        return false;
+    }
+
+    return true;
+}
+
+static bool parseSlot(const char *arg)
+{
+    SlotSpec s;
+    char *end;
+
+    s.index = strtoul(arg, &end, 10);
+    if (end == arg || *end != ':' || s.index > NUM_PRIVATE_KEYS - 2)
+        return false;
+
+    arg = end + 1;
+    s.firstNodeId = strtoul(arg, &end, 0);
+    if (end == arg || *end || !s.firstNodeId)
+        return false;
+
+    for (size_t i = 0 ; i < opt.slots.size() ; i++)
+        if (opt.slots[i].index == s.index || opt.slots[i].firstNodeId == s.firstNodeId)
+            return false;
+
+    opt.slots.push_back(s);
+    return true;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: fasito-provision -a <admin key file> [-o <manifest>] [options] [-d <serial device> ...]\n"
+            "  -a <file>       admin keys, created with new keys if it does not exist\n"
+            "  -o <file>       JSON manifest of the batch (needed with devices)\n"
+            "  -d <device>     token to provision, may be repeated\n"
+            "  -k <index>:<id> initialise key slot index with CVN ID id + n on the n-th token, may be repeated\n"
+            "  -p <PIN>        PIN for all tokens (default: a random PIN per token)\n"
+            "  -E <binary>     provision fasito-emu instances instead of devices\n"
+            "  -n <count>      number of emulators with -E (default: 1)\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int o;
+
+    while ((o = getopt(argc, argv, "a:o:d:k:p:E:n:")) != -1) {
+        switch (o) {
+        case 'a': opt.adminKeyFile = optarg; break;
+        case 'o': opt.manifest = optarg; break;
+        case 'd': opt.devices.push_back(optarg); break;
+        case 'k': if (!parseSlot(optarg)) usage(); break;
+        case 'p': opt.pin = optarg; break;
+        case 'E': opt.emulator = optarg; break;
+        case 'n': opt.numEmulators = atoi(optarg); break;
+        default: usage();
+        }
+    }
+
+    if (!opt.adminKeyFile || optind != argc || (opt.emulator && !opt.devices.empty()))
+        usage();
+
+    if (opt.emulator && (!opt.numEmulators || opt.numEmulators > MAX_EMULATORS))
+        usage();
+
+    const bool fProvision = opt.emulator || !opt.devices.empty();
+    if (fProvision && !opt.manifest)
+        usage();
+
+    if (opt.pin && (strlen(opt.pin) < 6 || strlen(opt.pin) > 9))
+        usage();
+
+    ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+
+    if (access(opt.adminKeyFile, F_OK) ? !createAdminKeyFile(opt.adminKeyFile) : !readAdminKeyFile(opt.adminKeyFile))
+        return 1;
+
+    if (!fProvision)
+        return 0;
+
+    std::vector<pid_t> emuPids;
+    std::vector<std::string> images, ports;
+
+    for (unsigned i = 0 ; opt.emulator && i < opt.numEmulators ; i++) {
+        char port[256], image[] = "/tmp/fasito-provision-XXXXXX";
+        pid_t pid;
+
+        int imageFd = mkstemp(image);
+        if (imageFd < 0) {
+            perror("mkstemp");
+            break;
+        }
+        close(imageFd);
+        unlink(image);
+
+        if (!spawnEmulator(opt.emulator, image, &pid, port, sizeof(port))) {
+            fprintf(stderr, "could not start %s\n", opt.emulator);
+            break;
+        }
+
+        emuPids.push_back(pid);
+        images.push_back(image);
+        ports.push_back(port);
+    }
+
+    std::vector<TokenResult> tokens;
+
+    if (opt.emulator) {
+        for (size_t i = 0 ; i < ports.size() ; i++)
+            opt.devices.push_back(ports[i].c_str());
+    }
+
+    tokens.resize(opt.devices.size());
+
+    const uint64_t start = nowUs();
+    std::vector<std::thread> workers;
+
+    for (size_t i = 0 ; i < opt.devices.size() ; i++) {
+        tokens[i].device = opt.devices[i];
+        tokens[i].seconds = 0;
+        workers.push_back(std::thread(worker, &tokens[i], (unsigned)i));
+    }
+
+    for (size_t i = 0 ; i < workers.size() ; i++)
+        workers[i].join();
+
+    unsigned nOK = 0;
+    for (size_t i = 0 ; i < tokens.size() ; i++)
+        if (tokens[i].error.empty())
+            nOK++;
+
+    fprintf(stderr, "provisioned %u of %u token(s) in %.1f s\n", nOK, (unsigned)tokens.size(), (nowUs() - start) / 1e6);
+
+    const bool fWritten = writeManifest(opt.manifest, tokens);
+
+    for (size_t i = 0 ; i < emuPids.size() ; i++) {
+        kill(emuPids[i], SIGTERM);
+        waitpid(emuPids[i], NULL, 0);
+        unlink(images[i].c_str());
+    }
+
+    secp256k1_context_destroy(ctx);
+
+    return fWritten && nOK == tokens.size() && (!opt.emulator || emuPids.size() == opt.numEmulators) ? 0 : 1;
+}
@@ -0,0 +1,894 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * fasito-trace.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Capture and replay of the traffic between a host and a Fasito token.
+ *
+ *   fasito-trace record -d /dev/ttyACM0 -l /tmp/fasito -o cvn.ftr
+ *
+ * puts a pseudo terminal (symlinked to -l) in front of the token; point the
+ * CVN at the symlink. Every line the token's loop() consumes and every
+ * response handleCommand() produces is written to the trace, timestamped.
+ * Secrets are redacted before they reach the file: PINs, device and seed keys
+ * in requests, and the ECDH and DUMP output.
+ *
+ *   fasito-trace replay -i cvn.ftr -E ./fasito-emu -e token.img [-f] [-p PIN]
+ *
+ * sends the requests again, at the recorded pacing or with -f as fast as the
+ * pipeline allows, diffs the responses and compares the latencies per command.
+ * Redacted requests are skipped, except LOGIN with the PIN given by -p.
+ *
+ *   fasito-trace dump -i cvn.ftr
+ *
+ * prints a trace as text.
+ *
+ * Both record and replay find the end of a response by its lines, so the
+ * traced session has to stay in HEX or BASE64, see host/libfasito.h.
+ *
+ * Trace file: a 16 byte header
+ *
+ *   "FTRC", version (1 byte), flags (1 byte), 2 reserved bytes,
+ *   capture start in us since the epoch (8 bytes, little endian)
+ *
+ * followed by records of
+ *
+ *   type (1 byte, bit 7: redacted), us since the previous record (LEB128),
+ *   length (LEB128), data
+ *
+ * REQUEST records hold a line without its '\r', RESPONSE records the output up
+ * to and including the "OK" or "ERROR" line. NOTICE records are lines the
+ * token sent with no request pending, PAYLOAD records the size of the image
+ * following an UPDATE line (LEB128); the image itself is not kept.
+ */
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "serial.h"
+#include "libfasito.h"
+
+#define TRACE_VERSION           1
+#define TRACE_HEADER_SIZE       16
+#define TRACE_REDACTED          0x80
+
+#define MAX_DIFFS               10
+
+enum {
+    REC_REQUEST = 1,
+    REC_RESPONSE,
+    REC_NOTICE,
+    REC_PAYLOAD,
+};
+
+typedef struct Record {
+    uint8_t type;
+    bool redacted;
+    uint64_t us;            /* since the start of the capture */
+    std::string data;
+} Record;
+
+/* command arguments and responses that never go to a trace, matched like getCommand() */
+typedef struct Secret {
+    const char *command;
+    uint8_t len;
+    uint8_t args;           /* bit n: argument n is secret */
+    bool response;          /* the response data is secret */
+} Secret;
+
+static const Secret secrets[] = {
+        {"LOGIN",   5, 0x01, false},
+        {"CHGPIN",  6, 0x03, false},
+        {"RSTPIN",  6, 0x01, false},
+        {"INITKEY", 7, 0x04, false},
+        {"INIT",    4, 0x11, false},
+        {"SETKEY",  6, 0x04, false},
+        {"ECDH",    4, 0x00, true },
+        {"DUMP",    4, 0x00, true },
+};
+
+static volatile sig_atomic_t stopped = 0;
+
+static void onSignal(int)
+{
+    stopped = 1;
+}
+
+static const Secret *findSecret(const std::string &line)
+{
+    for (size_t i = 0 ; i < sizeof(secrets) / sizeof(Secret) ; i++)
+        if (!line.compare(0, secrets[i].len, secrets[i].command))
+            return &secrets[i];
+
+    return NULL;
+}
+
+/* the command name as the token reads it, for the per command report */
+static std::string commandName(const std::string &line)
+{
+    return line.substr(0, line.find(' '));
+}
+
+/* overwrites the secret arguments of a request line, returns their clear text for scrubbing the echo */
+static std::vector<std::string> redactRequest(std::string &line, const Secret *s)
+{
+    std::vector<std::string> clear;
+    size_t pos = s->len;
+
+    /* split like tokenise(): single spaces after the command */
+    for (unsigned n = 0 ; pos < line.length() && line[pos] == ' ' && n < 8 ; n++) {
+        const size_t start = pos + 1;
+        size_t end = line.find(' ', start);
+        if (end == std::string::npos)
+            end = line.length();
+
+        if ((s->args & (1 << n)) && end > start) {
+            clear.push_back(line.substr(start, end - start));
+            std::fill(line.begin() + start, line.begin() + end, '*');
+        }
+
+        pos = end;
+    }
+
+    return clear;
+}
+
+/* keeps the line structure and the final line, masks the data */
+static void redactResponse(std::string &response)
+{
+    size_t end = response.rfind("\r\n", response.length() - 3);
+    if (end == std::string::npos)
+        return;
+
+    for (size_t i = 0 ; i < end ; i++)
+        if (response[i] != '\r' && response[i] != '\n')
+            response[i] = '*';
+}
+
+static void scrub(std::string &s, const std::vector<std::string> &clear)
+{
+    for (size_t i = 0 ; i < clear.size() ; i++)
+        for (size_t pos = s.find(clear[i]) ; pos != std::string::npos ; pos = s.find(clear[i], pos))
+            std::fill(s.begin() + pos, s.begin() + pos + clear[i].length(), '*');
+}
+
+static bool isFinalLine(const char *l, size_t len)
+{
+    return (len == 2 && !memcmp(l, "OK", 2)) || (len >= 5 && !memcmp(l, "ERROR", 5));
+}
+
+/* trace file */
+
+static void putVarint(std::string &out, uint64_t v)
+{
+    do {
+        uint8_t b = v & 0x7f;
+        v >>= 7;
+        out += (char)(b | (v ? 0x80 : 0));
+    } while (v);
+}
+
+static bool getVarint(FILE *f, uint64_t *v)
+{
+    int c, shift = 0;
+
+    *v = 0;
+    do {
+        if ((c = fgetc(f)) == EOF || shift > 63)
+            return false;
+        *v |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    return true;
+}
+
+class TraceWriter
+{
+public:
+    TraceWriter() : f(NULL), last(0) {}
+
+    bool open(const char *path)
+    {
+        if (!(f = fopen(path, "wb")))
+            return false;
+
+        struct timeval tv;
+        gettimeofday(&tv, NULL);
+        uint64_t epochUs = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+
+        uint8_t header[TRACE_HEADER_SIZE] = { 'F', 'T', 'R', 'C', TRACE_VERSION, 0, 0, 0 };
+        for (int i = 0 ; i < 8 ; i++)
+            header[8 + i] = epochUs >> (8 * i);
+
+        last = nowUs();
+        return fwrite(header, 1, sizeof(header), f) == sizeof(header);
+    }
+
+    bool write(uint8_t type, bool redacted, const std::string &data, uint64_t at)
+    {
+        std::string rec(1, (char)(type | (redacted ? TRACE_REDACTED : 0)));
+
+        putVarint(rec, at - last);
+        putVarint(rec, data.length());
+        rec += data;
+        last = at;
+
+        /* a capture usually ends with a signal, keep the file complete */
+        return fwrite(rec.data(), 1, rec.length(), f) == rec.length() && !fflush(f);
+    }
+
+    bool close()
+    {
+        return f && !fclose(f);
+    }
+
+private:
+    FILE *f;
+    uint64_t last;
+};
+
+static bool readTrace(const char *path, std::vector<Record> &records, uint64_t *epochUs)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+
+    uint8_t header[TRACE_HEADER_SIZE];
+    if (fread(header, 1, sizeof(header), f) != sizeof(header) || memcmp(header, "FTRC", 4) || header[4] != TRACE_VERSION) {
+        fprintf(stderr, "%s: not a Fasito trace\n", path);
+        fclose(f);
+        return false;
+    }
+
+    *epochUs = 0;
+    for (int i = 0 ; i < 8 ; i++)
+        *epochUs |= (uint64_t)header[8 + i] << (8 * i);
+
+    uint64_t us = 0;
+    int c;
+
+    while ((c = fgetc(f)) != EOF) {
+        Record r;
+        uint64_t delta, len;
+
+        if (!getVarint(f, &delta) || !getVarint(f, &len) || len > (1 << 24)) {
+            fprintf(stderr, "%s: truncated record %zu\n", path, records.size());
+            break;
+        }
+
+        r.type = c & ~TRACE_REDACTED;
+        r.redacted = c & TRACE_REDACTED;
+        r.us = us += delta;
+        r.data.resize(len);
+
+        if (len && fread(&r.data[0], 1, len, f) != len) {
+            fprintf(stderr, "%s: truncated record %zu\n", path, records.size());
+            break;
+        }
+
+        records.push_back(r);
+    }
+
+    fclose(f);
+    return true;
+}
+
+/* record */
+
+static int openPTY(const char *link, int *slave)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0)
+        return -1;
+
+    const char *name = ptsname(master);
+
+    /* like fasito-emu: keep the slave open in raw mode, so the master never sees a hangup */
+    struct termios tio;
+    if ((*slave = open(name, O_RDWR | O_NOCTTY)) < 0 || tcgetattr(*slave, &tio) < 0)
+        return -1;
+
+    cfmakeraw(&tio);
+    tcsetattr(*slave, TCSANOW, &tio);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+
+    if (link) {
+        unlink(link);
+        if (symlink(name, link) < 0)
+            return -1;
+    }
+
+    fprintf(stderr, "fasito-trace: serial port %s\n", link ? link : name);
+    return master;
+}
+
+typedef struct Pending {
+    const Secret *secret;
+    std::vector<std::string> clear;
+} Pending;
+
+class Recorder
+{
+public:
+    Recorder(TraceWriter &trace) : requests(0), responses(0), trace(trace), payloadLeft(0) {}
+
+    /* host to token: lines are forwarded when complete, the UPDATE image as it comes */
+    void fromHost(const char *buf, size_t len, int device)
+    {
+        while (len) {
+            if (payloadLeft) {
+                const size_t n = std::min((uint64_t)len, payloadLeft);
+                writeSerial(device, buf, n);
+                buf += n;
+                len -= n;
+                payloadLeft -= n;
+                continue;
+            }
+
+            const char *cr = (const char *)memchr(buf, '\r', len);
+            if (!cr) {
+                line.append(buf, len);
+                return;
+            }
+
+            line.append(buf, cr - buf);
+            const size_t n = cr - buf + 1;
+            buf += n;
+            len -= n;
+
+            request(device);
+            line.clear();
+        }
+    }
+
+    /* token to host: forwarded unchanged, responses are matched to requests in order */
+    void fromDevice(const char *buf, size_t len)
+    {
+        const uint64_t now = nowUs();
+
+        rx.append(buf, len);
+
+        size_t start = 0, eol;
+        while ((eol = rx.find("\r\n", start)) != std::string::npos) {
+            const char *l = rx.data() + start;
+            const size_t lineLen = eol - start;
+            start = eol + 2;
+
+            if (pending.empty()) {
+                std::string notice(l, lineLen);
+                trace.write(REC_NOTICE, false, notice, now);
+                rx.erase(0, start);
+                start = 0;
+                continue;
+            }
+
+            if (!isFinalLine(l, lineLen))
+                continue;
+
+            std::string response = rx.substr(0, start);
+            rx.erase(0, start);
+            start = 0;
+
+            Pending &p = pending.front();
+            bool redacted = !p.clear.empty();
+
+            if (p.secret && p.secret->response) {
+                redactResponse(response);
+                redacted = true;
+            }
+            scrub(response, p.clear);
+
+            trace.write(REC_RESPONSE, redacted, response, now);
+            pending.erase(pending.begin());
+            responses++;
+        }
+    }
+
+    unsigned requests;
+    unsigned responses;
+
+private:
+    void request(int device)
+    {
+        const uint64_t now = nowUs();
+        std::string forward = line + "\r";
+
+        writeSerial(device, forward.data(), forward.length());
+
+        /* loop() ignores empty lines */
+        if (line.empty())
+            return;
+
+        Pending p;
+        p.secret = findSecret(line);
+
+        std::string recorded = line;
+        if (p.secret)
+            p.clear = redactRequest(recorded, p.secret);
+
+        trace.write(REC_REQUEST, !p.clear.empty(), recorded, now);
+        pending.push_back(p);
+        requests++;
+
+        /* cmdUpdateFirmware() reads the image from the serial port */
+        unsigned size;
+        if (!line.compare(0, 7, "UPDATE ") && sscanf(line.c_str() + 7, "0x%x", &size) == 1) {
+            std::string data;
+            putVarint(data, size);
+            trace.write(REC_PAYLOAD, false, data, now);
+            payloadLeft = size;
+        }
+    }
+
+    TraceWriter &trace;
+    std::string line;
+    std::string rx;
+    std::vector<Pending> pending;
+    uint64_t payloadLeft;
+};
+
+static int record(int argc, char **argv)
+{
+    const char *device = NULL, *link = NULL, *output = NULL;
+    int o;
+
+    while ((o = getopt(argc, argv, "d:l:o:")) != -1) {
+        switch (o) {
+        case 'd': device = optarg; break;
+        case 'l': link = optarg; break;
+        case 'o': output = optarg; break;
+        default: return -1;
+        }
+    }
+
+    if (!device || !output)
+        return -1;
+
+    int dev = openSerial(device);
+    if (dev < 0) {
+        perror(device);
+        return 1;
+    }
+
+    TraceWriter trace;
+    if (!trace.open(output)) {
+        perror(output);
+        return 1;
+    }
+
+    int slave, master = openPTY(link, &slave);
+    if (master < 0) {
+        perror("pseudo terminal");
+        return 1;
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    Recorder recorder(trace);
+    char buf[4096];
+    int ret = 0;
+
+    while (!stopped) {
+        struct pollfd p[2] = { { master, POLLIN, 0 }, { dev, POLLIN, 0 } };
+
+        if (poll(p, 2, 200) < 0)
+            continue;
+
+        if (p[0].revents & POLLIN) {
+            ssize_t n = read(master, buf, sizeof(buf));
+            if (n > 0)
+                recorder.fromHost(buf, n, dev);
+        }
+
+        if (p[1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(dev, buf, sizeof(buf));
+            if (n <= 0 && errno != EAGAIN && errno != EINTR) {
+                fprintf(stderr, "%s: device disconnected\n", device);
+                ret = 1;
+                break;
+            }
+
+            if (n > 0) {
+                writeSerial(master, buf, n);
+                recorder.fromDevice(buf, n);
+            }
+        }
+    }
+
+    fprintf(stderr, "recorded %u requests, %u responses\n", recorder.requests, recorder.responses);
+
+    if (link)
+        unlink(link);
+    close(master);
+    close(slave);
+    close(dev);
+
+    return trace.close() ? ret : 1;
+}
+
+/* replay */
+
+typedef struct Exchange {
+    std::string line;
+    bool redacted;
+    uint64_t sentUs;            /* recorded */
+    uint32_t latencyUs;
+    std::string response;
+    bool responseRedacted;
+    bool answered;
+    bool skipped;
+    FasitoResponse replayed;
+} Exchange;
+
+static std::vector<Exchange> pairExchanges(const std::vector<Record> &records)
+{
+    std::vector<Exchange> exchanges;
+    size_t next = 0;
+
+    for (size_t i = 0 ; i < records.size() ; i++) {
+        const Record &r = records[i];
+
+        if (r.type == REC_REQUEST) {
+            Exchange e;
+            e.line = r.data;
+            e.redacted = r.redacted;
+            e.sentUs = r.us;
+            e.latencyUs = 0;
+            e.responseRedacted = false;
+            e.answered = false;
+            /* a firmware update would restart the token, the image is not in the trace anyway */
+            e.skipped = !e.line.compare(0, 7, "UPDATE ");
+            exchanges.push_back(e);
+        } else if (r.type == REC_RESPONSE && next < exchanges.size()) {
+            Exchange &e = exchanges[next++];
+            e.response = r.data;
+            e.responseRedacted = r.redacted;
+            e.latencyUs = r.us - e.sentUs;
+            e.answered = true;
+        }
+    }
+
+    return exchanges;
+}
+
+static std::vector<std::string> splitLines(const std::string &s)
+{
+    std::vector<std::string> lines;
+    size_t start = 0, eol;
+
+    while ((eol = s.find("\r\n", start)) != std::string::npos) {
+        lines.push_back(s.substr(start, eol - start));
+        start = eol + 2;
+    }
+
+    return lines;
+}
+
+static bool sameResponse(const Exchange &e, const std::set<std::string> &ignored, bool *statusOnly)
+{
+    std::vector<std::string> a = splitLines(e.response), b = splitLines(e.replayed.raw);
+
+    *statusOnly = e.responseRedacted || ignored.count(commandName(e.line));
+
+    if (*statusOnly)
+        return !a.empty() && !b.empty() && a.back().compare(0, 5, b.back(), 0, 5) == 0;
+
+    return a == b;
+}
+
+static void printDiff(size_t n, const Exchange &e)
+{
+    std::vector<std::string> a = splitLines(e.response), b = splitLines(e.replayed.raw);
+
+    printf("#%zu %.60s\n", n, e.line.c_str());
+    for (size_t i = 0 ; i < std::max(a.size(), b.size()) ; i++) {
+        if (i < a.size() && i < b.size() && a[i] == b[i])
+            continue;
+        if (i < a.size())
+            printf("- %s\n", a[i].c_str());
+        if (i < b.size())
+            printf("+ %s\n", b[i].c_str());
+    }
+}
+
+static uint32_t percentile(std::vector<uint32_t> &v, double p)
+{
+    if (v.empty())
+        return 0;
+
+    std::sort(v.begin(), v.end());
+    return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+static void printLatencies(const std::vector<Exchange> &exchanges)
+{
+    std::map<std::string, std::pair<std::vector<uint32_t>, std::vector<uint32_t> > > latencies;
+
+    for (size_t i = 0 ; i < exchanges.size() ; i++) {
+        const Exchange &e = exchanges[i];
+        if (e.skipped || !e.answered || !e.replayed.doneUs)
+            continue;
+
+        latencies[commandName(e.line)].first.push_back(e.latencyUs);
+        latencies[commandName(e.line)].second.push_back(e.replayed.latencyUs());
+    }
+
+    printf("\n%-8s %7s %12s %12s %12s %12s\n", "command", "count", "rec p50/us", "rep p50/us", "rec p99/us", "rep p99/us");
+
+    for (auto &l : latencies) {
+        std::vector<uint32_t> &rec = l.second.first, &rep = l.second.second;
+
+        printf("%-8s %7zu %12u %12u %12u %12u\n", l.first.c_str(), rec.size(),
+               percentile(rec, 0.5), percentile(rep, 0.5), percentile(rec, 0.99), percentile(rep, 0.99));
+    }
+}
+
+static int replay(int argc, char **argv)
+{
+    const char *input = NULL, *device = NULL, *emulator = NULL, *image = NULL, *pin = NULL;
+    bool fast = false;
+    unsigned inFlight = 1;
+    std::set<std::string> ignored = { "STATS", "IOSTAT", "BENCH" };
+    int o;
+
+    while ((o = getopt(argc, argv, "i:d:E:e:fp:c:x:")) != -1) {
+        switch (o) {
+        case 'i': input = optarg; break;
+        case 'd': device = optarg; break;
+        case 'E': emulator = optarg; break;
+        case 'e': image = optarg; break;
+        case 'f': fast = true; break;
+        case 'p': pin = optarg; break;
+        case 'c': inFlight = atoi(optarg); break;
+        case 'x': ignored.insert(optarg); break;
+        default: return -1;
+        }
+    }
+
+    if (!input || !device == !emulator || (image && !emulator) || !inFlight)
+        return -1;
+
+    std::vector<Record> records;
+    uint64_t epochUs;
+    if (!readTrace(input, records, &epochUs))
+        return 1;
+
+    std::vector<Exchange> exchanges = pairExchanges(records);
+    unsigned skipped = 0;
+
+    for (size_t i = 0 ; i < exchanges.size() ; i++) {
+        Exchange &e = exchanges[i];
+
+        if (e.redacted && pin && !e.line.compare(0, 6, "LOGIN "))
+            e.line = "LOGIN " + std::string(pin);
+        else if (e.redacted)
+            e.skipped = true;
+
+        if (e.skipped)
+            skipped++;
+    }
+
+    /* the emulator runs on a copy, so every replay starts from the same state */
+    char port[256], copy[] = "/tmp/fasito-trace-XXXXXX";
+    pid_t emuPid = 0;
+
+    if (emulator) {
+        int fd = mkstemp(copy);
+        if (fd < 0) {
+            perror("mkstemp");
+            return 1;
+        }
+
+        if (image) {
+            FILE *in = fopen(image, "rb");
+            char buf[4096];
+            size_t n;
+
+            if (!in) {
+                perror(image);
+                close(fd);
+                unlink(copy);
+                return 1;
+            }
+
+            while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+                if (write(fd, buf, n) != (ssize_t)n)
+                    break;
+            fclose(in);
+        } else
+            unlink(copy);
+        close(fd);
+
+        if (!spawnEmulator(emulator, copy, &emuPid, port, sizeof(port))) {
+            fprintf(stderr, "could not start %s\n", emulator);
+            unlink(copy);
+            return 1;
+        }
+
+        device = port;
+    }
+
+    FasitoClient client(inFlight);
+    if (!client.open(device, emulator ? 2500 : 500)) {
+        perror(device);
+        return 1;
+    }
+
+    const uint64_t start = nowUs();
+    const char *aborted = NULL;
+
+    for (size_t i = 0 ; i < exchanges.size() && !aborted ; i++) {
+        Exchange &e = exchanges[i];
+        if (e.skipped)
+            continue;
+
+        while (!fast && nowUs() < start + e.sentUs && client.process(std::max(1, (int)((start + e.sentUs - nowUs()) / 1000))))
+            ;
+
+        client.call(e.line, [&e, &aborted](const FasitoResponse &r) {
+            e.replayed = r;
+            if (r.error == "timeout" || r.error == "device disconnected")
+                aborted = "device lost";
+        });
+
+        /* keep the pipeline at its limit */
+        while (client.outstanding() >= inFlight && client.process(100))
+            ;
+    }
+
+    while (client.outstanding() && client.process(100))
+        ;
+
+    const double seconds = (nowUs() - start) / 1e6;
+    client.close();
+
+    if (emuPid) {
+        kill(emuPid, SIGTERM);
+        waitpid(emuPid, NULL, 0);
+        unlink(copy);
+    }
+
+    unsigned same = 0, statusOnly = 0, different = 0, unanswered = 0;
+
+    for (size_t i = 0 ; i < exchanges.size() ; i++) {
+        Exchange &e = exchanges[i];
+        bool fStatusOnly;
+
+        if (e.skipped)
+            continue;
+
+        if (!e.answered) {
+            unanswered++;
+            continue;
+        }
+
+        if (sameResponse(e, ignored, &fStatusOnly)) {
+            same++;
+            if (fStatusOnly)
+                statusOnly++;
+        } else if (++different <= MAX_DIFFS)
+            printDiff(i, e);
+    }
+
+    printLatencies(exchanges);
+
+    printf("\n%zu requests in %.2f s (recorded %.2f s): %u identical (%u by status only), %u different, %u skipped, %u unanswered in the trace\n",
+           exchanges.size(), seconds, records.empty() ? 0.0 : records.back().us / 1e6, same, statusOnly, different, skipped, unanswered);
+
+    if (aborted)
+        fprintf(stderr, "replay aborted: %s\n", aborted);
+
+    return different || aborted ? 1 : 0;
+}
+
+/* dump */
+
+static int dump(int argc, char **argv)
+{
+    const char *input = NULL;
+    int o;
+
+    while ((o = getopt(argc, argv, "i:")) != -1) {
+        switch (o) {
+        case 'i': input = optarg; break;
+        default: return -1;
+        }
+    }
+
+    std::vector<Record> records;
+    uint64_t epochUs;
+
+    if (!input || !readTrace(input, records, &epochUs))
+        return input ? 1 : -1;
+
+    const time_t t = epochUs / 1000000;
+    printf("# captured %s", ctime(&t));
+
+    static const char *marks[] = { "?", ">", "<", "!", "=" };
+
+    for (size_t i = 0 ; i < records.size() ; i++) {
+        const Record &r = records[i];
+        const char *mark = r.type <= REC_PAYLOAD ? marks[r.type] : marks[0];
+
+        if (r.type == REC_PAYLOAD) {
+            uint64_t size = 0;
+            for (size_t k = 0 ; k < r.data.length() && k < 10 ; k++)
+                size |= (uint64_t)(r.data[k] & 0x7f) << (7 * k);
+            printf("%12.6f %s <%llu bytes of image>\n", r.us / 1e6, mark, (unsigned long long)size);
+            continue;
+        }
+
+        std::vector<std::string> lines = r.type == REC_RESPONSE ? splitLines(r.data) : std::vector<std::string>(1, r.data);
+        for (size_t k = 0 ; k < lines.size() ; k++)
+            printf("%12.6f %s %s%s\n", r.us / 1e6, mark, lines[k].c_str(), r.redacted && !k ? "  [redacted]" : "");
+    }
+
+    return 0;
+}
+
+static void usage()
+{
+    fprintf(stderr,
+            "usage: fasito-trace record -d <serial device> -o <trace> [-l <pty symlink>]\n"
+            "       fasito-trace replay -i <trace> (-d <serial device> | -E <fasito-emu binary> [-e <eeprom image>]) [options]\n"
+            "         -f          as fast as possible instead of the recorded pacing\n"
+            "         -p <PIN>    replay the redacted LOGINs with this PIN\n"
+            "         -c <n>      requests in flight (default: 1)\n"
+            "         -x <cmd>    compare only OK/ERROR of cmd, may be repeated (default: STATS, IOSTAT, BENCH)\n"
+            "       fasito-trace dump -i <trace>\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int ret = -1;
+
+    if (argc < 2)
+        usage();
+
+    if (!strcmp(argv[1], "record"))
+        ret = record(argc - 1, argv + 1);
+    else if (!strcmp(argv[1], "replay"))
+        ret = replay(argc - 1, argv + 1);
+    else if (!strcmp(argv[1], "dump"))
+        ret = dump(argc - 1, argv + 1);
+
+    if (ret < 0)
+        usage();
+
+    return ret;
+}
@@ -0,0 +1,720 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * libfasito.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "serial.h"
+#include "libfasito.h"
+
+#define RX_CHUNK 4096
+
+/* command lines may carry key material (INIT, INITKEY), zeroed before they are freed */
+static void wipe(std::string &s)
+{
+    volatile char *v = &s[0];
+
+    for (size_t i = 0 ; i < s.size() ; i++)
+        v[i] = 0;
+    s.clear();
+}
+
+FasitoClient::Request::~Request()
+{
+    wipe(line);
+}
+
+static bool isHex(const std::string &s, size_t bytes)
+{
+    if (s.size() != bytes * 2)
+        return false;
+
+    for (size_t i = 0 ; i < s.size() ; i++)
+        if (!isxdigit((unsigned char)s[i]))
+            return false;
+
+    return true;
+}
+
+static bool isToken(const std::string &s)
+{
+    return !s.empty() && s.find_first_of(" \r\n") == std::string::npos;
+}
+
+bool parseNonceResponse(const FasitoResponse &r, unsigned *slot, std::string *publicNonce)
+{
+    if (!r.ok || r.lineCount() < 1)
+        return false;
+
+    const char *l = r.lineData(0);
+    const size_t len = r.lineLength(0);
+
+    if (len != 131 || l[2] != ' ' || !isdigit((unsigned char)l[0]) || !isdigit((unsigned char)l[1]))
+        return false;
+
+    *slot = (l[0] - '0') * 10 + l[1] - '0';
+    publicNonce->assign(l + 3, 128);
+
+    return true;
+}
+
+FasitoClient::FasitoClient(unsigned maxInFlight, unsigned timeoutMs) :
+        fd(-1), maxInFlight(maxInFlight ? maxInFlight : 1), timeoutMs(timeoutMs), txOffset(0), scanned(0), lineStart(0), resyncStarted(0), running(false)
+{
+    if (pipe(wakeFds) < 0)
+        wakeFds[0] = wakeFds[1] = -1;
+
+    for (int i = 0 ; i < 2 ; i++)
+        if (wakeFds[i] >= 0)
+            fcntl(wakeFds[i], F_SETFL, fcntl(wakeFds[i], F_GETFL) | O_NONBLOCK);
+}
+
+FasitoClient::~FasitoClient()
+{
+    close();
+
+    for (int i = 0 ; i < 2 ; i++)
+        if (wakeFds[i] >= 0)
+            ::close(wakeFds[i]);
+}
+
+bool FasitoClient::open(const char *path, int quietMs)
+{
+    int f = openSerial(path);
+
+    if (f < 0)
+        return false;
+
+    /* without waiting, the resynchronisation skips whatever the token sends first */
+    if (quietMs < 0) {
+        attach(f);
+        startResync();
+        return true;
+    }
+
+    /* skip the boot banner and terminate a partial line */
+    drainSerial(f, quietMs);
+    writeSerial(f, "\r", 1);
+    drainSerial(f, 100);
+
+    attach(f);
+    return true;
+}
+
+void FasitoClient::attach(int f)
+{
+    close();
+
+    fd = f;
+    wipe(tx);
+    txOffset = 0;
+    rx.clear();
+    lines.clear();
+    scanned = lineStart = 0;
+    resyncMarker.clear();
+}
+
+void FasitoClient::close()
+{
+    stop();
+
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+
+    failAll("connection closed");
+}
+
+bool FasitoClient::start()
+{
+    if (running || fd < 0)
+        return false;
+
+    running = true;
+    loopThread = std::thread([this]() {
+        while (running && process(100))
+            ;
+        running = false;
+    });
+
+    return true;
+}
+
+void FasitoClient::stop()
+{
+    if (!loopThread.joinable())
+        return;
+
+    running = false;
+    wake();
+    loopThread.join();
+}
+
+void FasitoClient::wake()
+{
+    if (wakeFds[1] >= 0 && write(wakeFds[1], "", 1) < 0)
+        return;
+}
+
+FasitoResponse FasitoClient::wait(FasitoFuture &f)
+{
+    while (!running && f.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        if (!process(100))
+            break;
+
+    return f.get();
+}
+
+size_t FasitoClient::outstanding()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return queue.size() + inFlight.size();
+}
+
+void FasitoClient::complete(Request &r, FasitoResponse &response)
+{
+    response.queuedUs = r.queued;
+    response.sentUs = r.sent ? r.sent : response.doneUs;
+
+    if (r.cb)
+        r.cb(response);
+
+    r.promise->set_value(response);
+}
+
+void FasitoClient::failAll(const char *error)
+{
+    std::deque<Request> failed;
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        failed.swap(inFlight);
+        while (!queue.empty()) {
+            failed.push_back(queue.front());
+            queue.pop_front();
+        }
+    }
+
+    rx.clear();
+    lines.clear();
+    scanned = lineStart = 0;
+    wipe(tx);
+    txOffset = 0;
+
+    for (size_t i = 0 ; i < failed.size() ; i++) {
+        FasitoResponse response;
+        response.error = error;
+        response.doneUs = nowUs();
+        complete(failed[i], response);
+    }
+}
+
+FasitoFuture FasitoClient::submit(const std::string &line, const std::string &payload, bool exclusive, FasitoCallback cb)
+{
+    Request r;
+
+    r.line.reserve(line.size() + 1);
+    r.line.append(line);
+    r.line.append("\r");
+    r.payload = payload;
+    r.exclusive = exclusive;
+    r.cb = cb;
+    r.promise = std::make_shared<std::promise<FasitoResponse> >();
+    r.queued = nowUs();
+    r.sent = 0;
+
+    FasitoFuture f = r.promise->get_future();
+
+    if (fd < 0) {
+        FasitoResponse response;
+        response.error = "not connected";
+        response.doneUs = r.queued;
+        complete(r, response);
+        return f;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        queue.push_back(r);
+    }
+
+    wake();
+    return f;
+}
+
+FasitoFuture FasitoClient::reject(const char *error, FasitoCallback cb)
+{
+    Request r;
+    FasitoResponse response;
+
+    r.cb = cb;
+    r.promise = std::make_shared<std::promise<FasitoResponse> >();
+    r.queued = r.sent = response.doneUs = nowUs();
+    response.error = error;
+
+    FasitoFuture f = r.promise->get_future();
+    complete(r, response);
+
+    return f;
+}
+
+/* The responses of timed out requests may still come, they would complete the
+ * next requests. The token is switched to ECHO for a marker line, once its echo
+ * and the ECHO that switches it off again are back, everything before is late
+ * output and dropped. New requests wait until then.
+ */
+void FasitoClient::startResync()
+{
+    char marker[32];
+
+    snprintf(marker, sizeof(marker), "SYNC%016llx", (unsigned long long)nowUs());
+    resyncMarker = marker;
+    resyncStarted = nowUs();
+
+    /* the leading \r terminates a partial line */
+    wipe(tx);
+    tx = "\rECHO\r" + resyncMarker + "\rECHO\r";
+    txOffset = 0;
+}
+
+bool FasitoClient::resyncDone()
+{
+    static const char echoOff[] = "echo is OFF\r\nOK\r\n";
+    const std::string marker = resyncMarker + "\r\n";
+    size_t pos = rx.find(marker);
+
+    if (pos == std::string::npos) {
+        /* keep what may be the start of the marker */
+        if (rx.size() > marker.size())
+            rx.erase(0, rx.size() - marker.size());
+        return false;
+    }
+
+    size_t end = rx.find(echoOff, pos + marker.size());
+    if (end == std::string::npos)
+        return false;
+
+    rx.erase(0, end + sizeof(echoOff) - 1);
+    resyncMarker.clear();
+    return true;
+}
+
+/* moves queued requests in flight, an exclusive request waits for and blocks everything else */
+void FasitoClient::sendQueued()
+{
+    if (!resyncMarker.empty())
+        return;
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    while (!queue.empty() && inFlight.size() < maxInFlight) {
+        if (!inFlight.empty() && (queue.front().exclusive || inFlight.back().exclusive))
+            break;
+
+        Request &r = queue.front();
+        r.sent = nowUs();
+        appendTx(r.line);
+        appendTx(r.payload);
+
+        inFlight.push_back(r);
+        queue.pop_front();
+    }
+}
+
+/* grows tx without leaving the old buffer with its requests in freed memory */
+void FasitoClient::appendTx(const std::string &s)
+{
+    if (tx.size() + s.size() > tx.capacity()) {
+        std::string grown;
+
+        grown.reserve(std::max(tx.capacity() * 2, tx.size() + s.size()));
+        grown.append(tx);
+        wipe(tx);
+        tx.swap(grown);
+    }
+
+    tx.append(s);
+}
+
+/* writes as much as the device takes without blocking, the rest waits for POLLOUT */
+bool FasitoClient::flushTx()
+{
+    while (txOffset < tx.size()) {
+        ssize_t n = write(fd, tx.data() + txOffset, tx.size() - txOffset);
+
+        if (n < 0)
+            return errno == EAGAIN || errno == EINTR;
+
+        txOffset += n;
+    }
+
+    wipe(tx);
+    txOffset = 0;
+
+    return true;
+}
+
+/* finds complete lines in rx, a final "OK" / "ERROR" line completes the oldest request */
+void FasitoClient::scanLines()
+{
+    size_t i;
+
+    for (i = scanned ; i + 1 < rx.size() ; i++) {
+        if (rx[i] != '\r' || rx[i + 1] != '\n')
+            continue;
+
+        const char *l = rx.data() + lineStart;
+        const size_t len = i - lineStart;
+        const size_t end = i + 2;
+
+        bool hasRequest;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            hasRequest = !inFlight.empty();
+        }
+
+        /* output nobody asked for, e.g. the boot banner */
+        if (!hasRequest) {
+            rx.erase(0, end);
+            lines.clear();
+            lineStart = 0;
+            i = (size_t)-1;
+            continue;
+        }
+
+        FasitoResponse::Span span = { (uint32_t)lineStart, (uint32_t)len };
+        lines.push_back(span);
+        lineStart = end;
+
+        const bool ok = len == 2 && !memcmp(l, "OK", 2);
+        if (!ok && (len < 5 || memcmp(l, "ERROR", 5))) {
+            i++;
+            continue;
+        }
+
+        /* hand the buffer over to the response, only bytes of the next response are copied */
+        FasitoResponse response;
+        response.ok = ok;
+        response.raw.swap(rx);
+        rx.assign(response.raw, end, std::string::npos);
+        response.raw.resize(end);
+        response.lines.swap(lines);
+        response.doneUs = nowUs();
+        if (!ok)
+            response.error.assign(l + (len > 6 ? 6 : len), len > 6 ? len - 6 : 0);
+
+        Request r;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            r = inFlight.front();
+            inFlight.pop_front();
+        }
+
+        lineStart = 0;
+        i = (size_t)-1;
+        complete(r, response);
+    }
+
+    scanned = rx.size() ? rx.size() - 1 : 0;
+}
+
+bool FasitoClient::receive()
+{
+    const size_t used = rx.size();
+
+    rx.resize(used + RX_CHUNK);
+    ssize_t n = read(fd, &rx[used], RX_CHUNK);
+    rx.resize(used + (n > 0 ? n : 0));
+
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+        return false;
+
+    if (!resyncMarker.empty() && !resyncDone())
+        return true;
+
+    scanLines();
+    return true;
+}
+
+bool FasitoClient::process(int waitMs)
+{
+    if (fd < 0)
+        return false;
+
+    sendQueued();
+    if (!flushTx()) {
+        failAll("write failed");
+        return false;
+    }
+
+    struct pollfd p[2] = { { fd, (short)(POLLIN | (tx.empty() ? 0 : POLLOUT)), 0 }, { wakeFds[0], POLLIN, 0 } };
+
+    if (poll(p, wakeFds[0] >= 0 ? 2 : 1, waitMs) < 0 && errno != EINTR)
+        return false;
+
+    if (wakeFds[0] >= 0 && (p[1].revents & POLLIN)) {
+        char buf[64];
+        while (read(wakeFds[0], buf, sizeof(buf)) > 0)
+            ;
+    }
+
+    if ((p[0].revents & (POLLIN | POLLHUP | POLLERR)) && !receive()) {
+        failAll("device disconnected");
+        return false;
+    }
+
+    if ((p[0].revents & POLLOUT) && !flushTx()) {
+        failAll("write failed");
+        return false;
+    }
+
+    uint64_t sent = 0;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!inFlight.empty())
+            sent = inFlight.front().sent;
+    }
+
+    /* the framing is lost after a timeout, start over with an empty pipeline */
+    if (sent && nowUs() - sent > timeoutMs * 1000ULL) {
+        failAll("timeout");
+        startResync();
+    }
+
+    /* the token does not answer at all any more */
+    if (!resyncMarker.empty() && nowUs() - resyncStarted > timeoutMs * 1000ULL) {
+        resyncMarker.clear();
+        failAll("device not responding");
+        return false;
+    }
+
+    return true;
+}
+
+FasitoFuture FasitoClient::call(const std::string &line, FasitoCallback cb)
+{
+    /* the token ends a line at \r only, a \n is part of the command line */
+    if (line.empty() || line.find('\r') != std::string::npos)
+        return reject("invalid command line", cb);
+
+    return submit(line, "", false, cb);
+}
+
+FasitoFuture FasitoClient::help(FasitoCallback cb) { return call("HELP", cb); }
+FasitoFuture FasitoClient::version(FasitoCallback cb) { return call("VERSION", cb); }
+FasitoFuture FasitoClient::echo(FasitoCallback cb) { return call("ECHO", cb); }
+FasitoFuture FasitoClient::logout(FasitoCallback cb) { return call("LOGOUT", cb); }
+FasitoFuture FasitoClient::seal(FasitoCallback cb) { return call("SEAL", cb); }
+FasitoFuture FasitoClient::unseal(FasitoCallback cb) { return call("UNSEAL", cb); }
+FasitoFuture FasitoClient::info(FasitoCallback cb) { return call("INFO", cb); }
+FasitoFuture FasitoClient::clearPool(FasitoCallback cb) { return call("CLRPOOL", cb); }
+FasitoFuture FasitoClient::deviceAdmins(FasitoCallback cb) { return call("DEVADM", cb); }
+FasitoFuture FasitoClient::ioStats(bool reset, FasitoCallback cb) { return call(reset ? "IOSTAT RESET" : "IOSTAT", cb); }
+FasitoFuture FasitoClient::stats(bool reset, FasitoCallback cb) { return call(reset ? "STATS RESET" : "STATS", cb); }
+FasitoFuture FasitoClient::memStats(bool reset, FasitoCallback cb) { return call(reset ? "MEMSTAT RESET" : "MEMSTAT", cb); }
+FasitoFuture FasitoClient::tasks(bool reset, FasitoCallback cb) { return call(reset ? "TASKS RESET" : "TASKS", cb); }
+
+FasitoFuture FasitoClient::login(const std::string &pin, FasitoCallback cb)
+{
+    if (!isToken(pin))
+        return reject("invalid PIN", cb);
+
+    return call("LOGIN " + pin, cb);
+}
+
+FasitoFuture FasitoClient::changePin(const std::string &oldPin, const std::string &newPin, FasitoCallback cb)
+{
+    if (!isToken(oldPin) || !isToken(newPin))
+        return reject("invalid PIN", cb);
+
+    return call("CHGPIN " + oldPin + " " + newPin, cb);
+}
+
+FasitoFuture FasitoClient::resetPin(const std::string &newPin, const std::string &adminSig, FasitoCallback cb)
+{
+    if (!isToken(newPin) || (!adminSig.empty() && !isToken(adminSig)))
+        return reject("invalid argument", cb);
+
+    return call("RSTPIN " + newPin + (adminSig.empty() ? "" : " " + adminSig), cb);
+}
+
+static std::string indexArg(unsigned index)
+{
+    char s[16];
+    snprintf(s, sizeof(s), " %u", index);
+    return s;
+}
+
+FasitoFuture FasitoClient::nonce(unsigned index, const std::string &hash, const std::string &random, FasitoCallback cb)
+{
+    if (!isHex(hash, 32) || !isHex(random, 32))
+        return reject("invalid hex parameter", cb);
+
+    return call("NONCE" + indexArg(index) + " " + hash + " " + random, cb);
+}
+
+FasitoFuture FasitoClient::singleNonce(unsigned index, const std::string &hash, const std::string &random, FasitoCallback cb)
+{
+    if (!isHex(hash, 32) || !isHex(random, 32))
+        return reject("invalid hex parameter", cb);
+
+    return call("SNONCE" + indexArg(index) + " " + hash + " " + random, cb);
+}
+
+FasitoFuture FasitoClient::partSig(unsigned index, unsigned slot, const std::string &hash, const std::string &otherNonces, FasitoCallback cb)
+{
+    if (!isHex(hash, 32) || !isHex(otherNonces, 64))
+        return reject("invalid hex parameter", cb);
+
+    return call("PARTSIG" + indexArg(index) + indexArg(slot) + " " + hash + " " + otherNonces, cb);
+}
+
+FasitoFuture FasitoClient::ecdsa(unsigned index, const std::string &hash, FasitoCallback cb)
+{
+    if (!isHex(hash, 32))
+        return reject("invalid hex parameter", cb);
+
+    return call("ECDSA" + indexArg(index) + " " + hash, cb);
+}
+
+FasitoFuture FasitoClient::schnorr(unsigned index, const std::string &hash, FasitoCallback cb)
+{
+    if (!isHex(hash, 32))
+        return reject("invalid hex parameter", cb);
+
+    return call("SCHNORR" + indexArg(index) + " " + hash, cb);
+}
+
+FasitoFuture FasitoClient::initKey(unsigned index, uint32_t nodeId, const std::string &hash, FasitoCallback cb)
+{
+    char id[16];
+
+    if (!isHex(hash, 32))
+        return reject("invalid hex parameter", cb);
+
+    snprintf(id, sizeof(id), " 0x%08x", nodeId);
+
+    /* the seed only goes into line, which is wiped */
+    std::string line = "INITKEY" + indexArg(index) + id + " ";
+    line.reserve(line.size() + hash.size());
+    line.append(hash);
+
+    FasitoFuture f = call(line, cb);
+    wipe(line);
+    return f;
+}
+
+FasitoFuture FasitoClient::init(const std::string &pin, const std::string adminKeys[3], const std::string &deviceKey, FasitoCallback cb)
+{
+    if (!isToken(pin) || !isHex(deviceKey, 32))
+        return reject("invalid argument", cb);
+
+    std::string line = "INIT " + pin;
+    for (int i = 0 ; i < 3 ; i++) {
+        if (!isHex(adminKeys[i], 65))
+            return reject("invalid admin public key", cb);
+        line += " " + adminKeys[i];
+    }
+
+    /* the device key only goes into line, which is wiped */
+    line.reserve(line.size() + 1 + deviceKey.size());
+    line.append(" ");
+    line.append(deviceKey);
+
+    FasitoFuture f = call(line, cb);
+    wipe(line);
+    return f;
+}
+
+FasitoFuture FasitoClient::erase(const std::string &adminSig, FasitoCallback cb)
+{
+    if (!adminSig.empty() && !isToken(adminSig))
+        return reject("invalid admin signature", cb);
+
+    return call("ERASE" + (adminSig.empty() ? "" : " " + adminSig), cb);
+}
+
+FasitoFuture FasitoClient::resetKey(unsigned index, const std::string &adminSig, FasitoCallback cb)
+{
+    if (!adminSig.empty() && !isToken(adminSig))
+        return reject("invalid admin signature", cb);
+
+    return call("RSTKEY" + indexArg(index) + (adminSig.empty() ? "" : " " + adminSig), cb);
+}
+
+FasitoFuture FasitoClient::txFlush(int timeoutMs, FasitoCallback cb)
+{
+    if (timeoutMs > 99)
+        return reject("invalid argument", cb);
+
+    return call(timeoutMs < 0 ? std::string("TXFLUSH") : "TXFLUSH" + indexArg(timeoutMs), cb);
+}
+
+FasitoFuture FasitoClient::encode(const std::string &name, FasitoCallback cb)
+{
+    if (!name.empty() && name != "HEX" && name != "BASE64")
+        return reject("unsupported encoding", cb);
+
+    return call(name.empty() ? std::string("ENCODE") : "ENCODE " + name, cb);
+}
+
+FasitoFuture FasitoClient::bench(unsigned iterations, FasitoCallback cb)
+{
+    return call("BENCH" + indexArg(iterations), cb);
+}
+
+FasitoFuture FasitoClient::getPublicKey(unsigned index, FasitoCallback cb)
+{
+    return call("GETPBKY" + indexArg(index), cb);
+}
+
+FasitoFuture FasitoClient::keyProof(unsigned index, FasitoCallback cb)
+{
+    return call("KYPROOF" + indexArg(index), cb);
+}
+
+FasitoFuture FasitoClient::ecdh(unsigned index, const std::string &derPublicKey, FasitoCallback cb)
+{
+    if (!isToken(derPublicKey))
+        return reject("invalid public key", cb);
+
+    return call("ECDH" + indexArg(index) + " " + derPublicKey, cb);
+}
+
+/* the image follows the command line as raw bytes, nothing else may be pipelined with it.
+ * A successful update resets the token, so the call ends with a timeout or a disconnect.
+ */
+FasitoFuture FasitoClient::update(const std::string &image, const std::string &adminSig, FasitoCallback cb)
+{
+    char size[16];
+
+    if (image.empty() || !isToken(adminSig))
+        return reject("invalid argument", cb);
+
+    snprintf(size, sizeof(size), " 0x%08zx", image.size());
+    return submit(std::string("UPDATE") + size + " " + adminSig, image, true, cb);
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * libfasito.h is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* libfasito: asynchronous host client for the Fasito text protocol.
+ *
+ * Requests are queued from any thread and pipelined to the token up to the
+ * in-flight limit. Every command of the token ends its response with "OK" or
+ * "ERROR <message>"; responses are matched to requests in order. Each call
+ * returns a future and optionally runs a callback from the I/O loop.
+ *
+ * A request without a response within the timeout fails together with all
+ * others in flight; the client then resynchronises with the token before it
+ * sends anything else, which relies on ECHO being off.
+ *
+ * The I/O loop either runs in its own thread (start()/stop()) or is driven by
+ * the application through process(), e.g. from its own poll loop.
+ *
+ * The typed calls check and send their values as hex and need a HEX session;
+ * use call() with base64 arguments after "ENCODE BASE64".
+ */
+
+#ifndef HOST_LIBFASITO_H_
+#define HOST_LIBFASITO_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define FASITO_DEFAULT_IN_FLIGHT    4
+#define FASITO_DEFAULT_TIMEOUT_MS   10000
+
+class FasitoResponse
+{
+public:
+    FasitoResponse() : ok(false), queuedUs(0), sentUs(0), doneUs(0) {}
+
+    bool ok;
+
+    /* the response as received, lines are kept as offsets into it */
+    std::string raw;
+
+    /* data lines, without the final "OK" / "ERROR" line */
+    size_t lineCount() const { return lines.empty() ? 0 : lines.size() - 1; }
+    const char *lineData(size_t i) const { return raw.data() + lines[i].offset; }
+    size_t lineLength(size_t i) const { return lines[i].length; }
+    std::string line(size_t i) const { return std::string(lineData(i), lineLength(i)); }
+
+    /* message of an "ERROR <message>" response or of a local failure */
+    std::string error;
+
+    /* per call timing in us of the monotonic clock */
+    uint64_t queuedUs;
+    uint64_t sentUs;
+    uint64_t doneUs;
+    uint32_t latencyUs() const { return doneUs - sentUs; }
+    uint32_t waitUs() const { return sentUs - queuedUs; }
+
+private:
+    friend class FasitoClient;
+
+    struct Span {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    std::vector<Span> lines;
+};
+
+typedef std::function<void(const FasitoResponse &)> FasitoCallback;
+typedef std::future<FasitoResponse> FasitoFuture;
+
+/* "<slot> <public nonce>" of NONCE and SNONCE */
+extern bool parseNonceResponse(const FasitoResponse &r, unsigned *slot, std::string *publicNonce);
+
+class FasitoClient
+{
+public:
+    FasitoClient(unsigned maxInFlight = FASITO_DEFAULT_IN_FLIGHT, unsigned timeoutMs = FASITO_DEFAULT_TIMEOUT_MS);
+    ~FasitoClient();
+
+    /* opens a tty; skips the boot banner when the token just came up. With
+     * quietMs < 0 it returns at once and the I/O loop resynchronises with the
+     * token before the first request is sent.
+     */
+    bool open(const char *path, int quietMs = 500);
+    /* uses an already opened, non-blocking fd, the client takes ownership */
+    void attach(int fd);
+    void close();
+    bool isOpen() const { return fd >= 0; }
+
+    /* background I/O thread */
+    bool start();
+    void stop();
+
+    /* one iteration of the I/O loop: writes queued requests, waits up to
+     * waitMs for input and completes responses. Returns false once the
+     * device is gone, all outstanding calls then fail.
+     */
+    bool process(int waitMs);
+    int fileDescriptor() const { return fd; }
+
+    /* waits for a call, drives the I/O loop itself when no thread runs it */
+    FasitoResponse wait(FasitoFuture &f);
+
+    size_t outstanding();
+    void setMaxInFlight(unsigned n) { maxInFlight = n ? n : 1; }
+
+    /* any command line */
+    FasitoFuture call(const std::string &line, FasitoCallback cb = FasitoCallback());
+
+    /* typed calls, one per entry of commands[] on the token; BENCH only exists
+     * on a BENCH=1 build, TXFLUSH with timeoutMs < 0 and ENCODE with an empty
+     * name print the current setting
+     */
+    FasitoFuture help(FasitoCallback cb = FasitoCallback());
+    FasitoFuture version(FasitoCallback cb = FasitoCallback());
+    FasitoFuture echo(FasitoCallback cb = FasitoCallback());
+    FasitoFuture login(const std::string &pin, FasitoCallback cb = FasitoCallback());
+    FasitoFuture logout(FasitoCallback cb = FasitoCallback());
+    FasitoFuture changePin(const std::string &oldPin, const std::string &newPin, FasitoCallback cb = FasitoCallback());
+    FasitoFuture resetPin(const std::string &newPin, const std::string &adminSig = "", FasitoCallback cb = FasitoCallback());
+    FasitoFuture nonce(unsigned index, const std::string &hash, const std::string &random, FasitoCallback cb = FasitoCallback());
+    FasitoFuture partSig(unsigned index, unsigned slot, const std::string &hash, const std::string &otherNonces, FasitoCallback cb = FasitoCallback());
+    FasitoFuture ecdsa(unsigned index, const std::string &hash, FasitoCallback cb = FasitoCallback());
+    FasitoFuture schnorr(unsigned index, const std::string &hash, FasitoCallback cb = FasitoCallback());
+    FasitoFuture seal(FasitoCallback cb = FasitoCallback());
+    FasitoFuture unseal(FasitoCallback cb = FasitoCallback());
+    FasitoFuture info(FasitoCallback cb = FasitoCallback());
+    FasitoFuture initKey(unsigned index, uint32_t nodeId, const std::string &hash, FasitoCallback cb = FasitoCallback());
+    FasitoFuture init(const std::string &pin, const std::string adminKeys[3], const std::string &deviceKey, FasitoCallback cb = FasitoCallback());
+    FasitoFuture erase(const std::string &adminSig = "", FasitoCallback cb = FasitoCallback());
+    FasitoFuture resetKey(unsigned index, const std::string &adminSig = "", FasitoCallback cb = FasitoCallback());
+    FasitoFuture getPublicKey(unsigned index, FasitoCallback cb = FasitoCallback());
+    FasitoFuture update(const std::string &image, const std::string &adminSig, FasitoCallback cb = FasitoCallback());
+    FasitoFuture singleNonce(unsigned index, const std::string &hash, const std::string &random, FasitoCallback cb = FasitoCallback());
+    FasitoFuture clearPool(FasitoCallback cb = FasitoCallback());
+    FasitoFuture keyProof(unsigned index, FasitoCallback cb = FasitoCallback());
+    FasitoFuture ecdh(unsigned index, const std::string &derPublicKey, FasitoCallback cb = FasitoCallback());
+    FasitoFuture deviceAdmins(FasitoCallback cb = FasitoCallback());
+    FasitoFuture ioStats(bool reset = false, FasitoCallback cb = FasitoCallback());
+    FasitoFuture stats(bool reset = false, FasitoCallback cb = FasitoCallback());
+    FasitoFuture memStats(bool reset = false, FasitoCallback cb = FasitoCallback());
+    FasitoFuture tasks(bool reset = false, FasitoCallback cb = FasitoCallback());
+    FasitoFuture txFlush(int timeoutMs = -1, FasitoCallback cb = FasitoCallback());
+    FasitoFuture encode(const std::string &name = "", FasitoCallback cb = FasitoCallback());
+    FasitoFuture bench(unsigned iterations, FasitoCallback cb = FasitoCallback());
+
+private:
+    struct Request {
+        ~Request();
+
+        std::string line;           /* zeroed when freed */
+        std::string payload;    /* raw bytes following the line (UPDATE) */
+        bool exclusive;         /* nothing else may be in flight */
+        FasitoCallback cb;
+        std::shared_ptr<std::promise<FasitoResponse> > promise;
+        uint64_t queued;
+        uint64_t sent;
+    };
+
+    FasitoFuture submit(const std::string &line, const std::string &payload, bool exclusive, FasitoCallback cb);
+    FasitoFuture reject(const char *error, FasitoCallback cb);
+    static void complete(Request &r, FasitoResponse &response);
+    void sendQueued();
+    void appendTx(const std::string &s);
+    bool flushTx();
+    bool receive();
+    void scanLines();
+    void failAll(const char *error);
+    void startResync();
+    bool resyncDone();
+    void wake();
+
+    int fd;
+    int wakeFds[2];
+    unsigned maxInFlight;
+    unsigned timeoutMs;
+
+    std::mutex lock;
+    std::deque<Request> queue;
+    std::deque<Request> inFlight;
+
+    /* bytes of in-flight requests not yet taken by the device */
+    std::string tx;
+    size_t txOffset;
+
+    /* receive buffer of the response in progress */
+    std::string rx;
+    size_t scanned;
+    size_t lineStart;
+    std::vector<FasitoResponse::Span> lines;
+
+    /* after a timeout: the line the token echoes once all late responses are out */
+    std::string resyncMarker;
+    uint64_t resyncStarted;
+
+    std::thread loopThread;
+    std::atomic<bool> running;
+};
+
+#endif /* HOST_LIBFASITO_H_ */
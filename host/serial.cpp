@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * serial.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "serial.h"
+
+int openSerial(const char *path)
+{
+    struct termios tio;
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+
+    if (fd < 0)
+        return -1;
+
+    if (tcgetattr(fd, &tio) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    /* the baud rate is ignored by USB CDC, but keep the tty from mangling the data */
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, B115200);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tio);
+    tcflush(fd, TCIOFLUSH);
+
+    return fd;
+}
+
+bool writeSerial(int fd, const char *buf, size_t len)
+{
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EINTR)
+                return false;
+
+            struct pollfd p = { fd, POLLOUT, 0 };
+            poll(&p, 1, 100);
+            continue;
+        }
+
+        buf += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+void drainSerial(int fd, int quietMs)
+{
+    char buf[512];
+    struct pollfd p = { fd, POLLIN, 0 };
+
+    while (poll(&p, 1, quietMs) > 0 && read(fd, buf, sizeof(buf)) > 0)
+        ;
+}
+
+bool spawnEmulator(const char *binary, const char *image, pid_t *pid, char *port, size_t portLen)
+{
+    int out[2];
+
+    if (pipe(out) < 0)
+        return false;
+
+    *pid = fork();
+    if (*pid < 0)
+        return false;
+
+    if (!*pid) {
+        dup2(out[1], STDOUT_FILENO);
+        close(out[0]);
+        close(out[1]);
+        execl(binary, binary, "-e", image, (char *)NULL);
+        _exit(127);
+    }
+
+    close(out[1]);
+
+    /* fasito-emu announces its port as "fasito-emu: serial port <path>" */
+    FILE *f = fdopen(out[0], "r");
+    char line[256], path[256];
+    bool fOK = f && fgets(line, sizeof(line), f) && sscanf(line, "fasito-emu: serial port %255s", path) == 1;
+
+    if (fOK)
+        snprintf(port, portLen, "%s", path);
+
+    if (f)
+        fclose(f);
+
+    return fOK;
+}
+
+uint64_t nowUs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * serial.h is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HOST_SERIAL_H_
+#define HOST_SERIAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/* opens a tty (USB CDC device or pseudo terminal) in raw, non-blocking mode, returns -1 on error */
+extern int openSerial(const char *path);
+
+/* writes the whole buffer, waiting while the device is busy */
+extern bool writeSerial(int fd, const char *buf, size_t len);
+
+/* reads and discards input until the device was quiet for quietMs */
+extern void drainSerial(int fd, int quietMs);
+
+/* starts fasito-emu with the given EEPROM image and returns the path of its serial port */
+extern bool spawnEmulator(const char *binary, const char *image, pid_t *pid, char *port, size_t portLen);
+
+/* monotonic time in us */
+extern uint64_t nowUs();
+
+#endif /* HOST_SERIAL_H_ */
@@ -0,0 +1,171 @@
+#!/bin/bash
+#
+# Copyright (c) 2020-2022 by Thomas König <tom@faircoin.world>
+#
+# fastrun.sh is part of Fasito, the FairCoin signature token.
+#
+# Fasito is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# Fasito is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with Fasito, see file COPYING.
+# If not, see <http://www.gnu.org/licenses/>.
+#
+
+#
+# RAM placement of hot code, used by "make FASTRUN=1":
+#
+#  lib     copies libsecp256k1.a and renames the sections of the functions
+#          listed in perf/fastrun.txt to .fastrun.*, which the linker script
+#          places in .data (RAM, copied from flash by the startup code)
+#  report  lists the .fastrun sections of Fasito.map with their RAM cost and,
+#          given the BENCH output of a flash and a FASTRUN build, compares the
+#          median cycles
+#
+# usage: fastrun.sh lib <libsecp256k1.a> <output.a> <fastrun.txt>
+#        fastrun.sh report <Fasito.map> [<BENCH output flash> <BENCH output FASTRUN>]
+#
+
+AR=${AR:-arm-none-eabi-ar}
+OBJCOPY=${OBJCOPY:-arm-none-eabi-objcopy}
+OBJDUMP=${OBJDUMP:-arm-none-eabi-objdump}
+
+usage() {
+	echo "usage: $0 lib <libsecp256k1.a> <output.a> <fastrun.txt>" >&2
+	echo "       $0 report <Fasito.map> [<BENCH output flash> <BENCH output FASTRUN>]" >&2
+	exit 2
+}
+
+# the section a list entry is renamed to
+fastrunName() {
+	case "$1" in
+	*:*)	member=${1%%:*}
+		echo ".fastrun.${member%.o}${1#*:}" ;;
+	*)	echo ".fastrun.$1" ;;
+	esac
+}
+
+lib() {
+	[ $# -eq 3 ] && [ -f "$1" ] && [ -f "$3" ] || usage
+
+	in=$(readlink -f "$1")
+	out=$(readlink -f "$(dirname "$2")")/$(basename "$2")
+	entries=$(sed -e 's/#.*//' -e 's/[ \t]*$//' -e '/^$/d' "$3")
+	tmp=$(mktemp -d)
+	trap 'rm -rf "$tmp"' EXIT
+
+	members=$(cd "$tmp" && $AR t "$in" && $AR x "$in") || exit 2
+	for m in $members; do
+		args=()
+		for e in $entries; do
+			case "$e" in
+			"$m":*)	args+=(--rename-section "${e#*:}=$(fastrunName "$e")") ;;
+			*:*)	;;
+			*)	args+=(--rename-section ".text.$e=$(fastrunName "$e")") ;;
+			esac
+		done
+		$OBJCOPY "${args[@]}" "$tmp/$m" || exit 2
+	done
+
+	rm -f "$out"
+	(cd "$tmp" && $AR rcs "$out" $members) || exit 2
+
+	# a renamed function that no longer exists would silently stay in flash
+	sections=$($OBJDUMP -h "$out" | awk '{ print $2 }')
+	for e in $entries; do
+		echo "$sections" | grep -qxF "$(fastrunName "$e")" ||
+			echo "$0: warning: $e not found in $1" >&2
+	done
+	return 0
+}
+
+report() {
+	[ $# -eq 1 ] || [ $# -eq 3 ] || usage
+	[ -f "$1" ] || usage
+
+	awk '
+	function hex(s,    i, v) {
+		s = tolower(s)
+		sub(/^0x/, "", s)
+		v = 0
+		for (i = 1 ; i <= length(s) ; i++)
+			v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+		return v
+	}
+	function input(name, size, file) {
+		if (size == 0 || name !~ /^\.fastrun/)
+			return
+		sub(/.*\//, "", file)
+		sub(/^\.fastrun\.?/, "", name)
+		if (name == "")
+			name = "FASTRUN functions"
+		printf "%8d  %s (%s)\n", size, name, file | "sort -rn"
+		total += size
+	}
+	$1 == "RAM" && $2 ~ /^0x/ && !ramSize { ramSize = hex($3) }
+	/^Linker script and memory map/ { inMap = 1; next }
+	!inMap { next }
+	/^\.[a-zA-Z_.]+[ \t]+0x[0-9a-f]+[ \t]+0x[0-9a-f]+/ { out[$1] = hex($3); next }
+	/^\.[a-zA-Z_.]+$/ { pendingOut = $1; next }
+	pendingOut != "" {
+		if ($1 ~ /^0x/ && $2 ~ /^0x/)
+			out[pendingOut] = hex($2)
+		pendingOut = ""
+		next
+	}
+	pending != "" {
+		if ($1 ~ /^0x/ && $2 ~ /^0x/)
+			input(pending, hex($2), $3)
+		pending = ""
+		next
+	}
+	/^ \.[^ \t]+$/ { pending = $1; next }
+	/^ \.[^ \t]+[ \t]+0x[0-9a-f]+[ \t]+0x[0-9a-f]+/ { input($1, hex($3), $4) }
+	END {
+		close("sort -rn")
+		ram = out[".usbdescriptortable"] + out[".dmabuffers"] + out[".usbbuffers"] + out[".data"] + out[".noinit"] + out[".bss"]
+		printf "%8d  bytes of code in RAM\n", total
+		printf "%8d  bytes of RAM used by .data/.bss/USB buffers", ram
+		if (ramSize)
+			printf " of %d, %d left for the heap and the stack", ramSize, ramSize - ram
+		printf "\n"
+	}' "$1"
+
+	[ $# -eq 3 ] || return 0
+
+	echo
+	awk 'BEGIN { printf "%-18s %10s %10s %8s\n", "median cycles", "flash", "FASTRUN", "delta" }
+	     /: min [0-9]+, median [0-9]+, max/ {
+		name = $0
+		sub(/ *:.*/, "", name)
+		median = $0
+		sub(/.*median /, "", median)
+		sub(/,.*/, "", median)
+		if (NR == FNR) {
+			flash[name] = median
+			names[n++] = name
+		} else
+			ram[name] = median
+	     }
+	     END {
+		for (i = 0 ; i < n ; i++) {
+			name = names[i]
+			if (!(name in ram) || !flash[name])
+				continue
+			printf "%-18s %10d %10d %+7.1f%%\n", name, flash[name], ram[name], (ram[name] - flash[name]) * 100 / flash[name]
+		}
+	     }' "$2" "$3"
+}
+
+case "$1" in
+lib)	shift; lib "$@" ;;
+report)	shift; report "$@" ;;
+*)	usage ;;
+esac
@@ -0,0 +1,181 @@
+#!/bin/bash
+#
+# Copyright (c) 2020-2022 by Thomas König <tom@faircoin.world>
+#
+# perf.sh is part of Fasito, the FairCoin signature token.
+#
+# Fasito is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# Fasito is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with Fasito, see file COPYING.
+# If not, see <http://www.gnu.org/licenses/>.
+#
+
+#
+# Performance regression gate, run by "make perf":
+#
+#  - section sizes and the size of every function from Fasito.map
+#  - the parser benchmarks of fasito-parsebench (ns, host dependent)
+#
+# The metrics listed in perf/baseline.txt are compared against their baseline
+# value; growing beyond the tolerance fails, and so does a metric the build no
+# longer produces. A metric whose baseline is still "-" is only reported, the
+# gate is not armed for it until "make perf-baseline" (-u) records the current
+# values. All function sizes are written to Fasito.sizes.
+#
+# usage: perf.sh [-u] <Fasito.map> <fasito-parsebench>
+#
+
+set -o pipefail
+
+BASELINE=${BASELINE:-perf/baseline.txt}
+CXXFILT=${CXXFILT:-c++filt}
+SIZES=Fasito.sizes
+
+update=0
+if [ "$1" = "-u" ]; then
+	update=1
+	shift
+fi
+
+if [ $# -ne 2 ] || [ ! -f "$1" ] || [ ! -x "$2" ]; then
+	echo "usage: $0 [-u] <Fasito.map> <fasito-parsebench>" >&2
+	exit 2
+fi
+
+map=$1
+bench=$2
+metrics=$(mktemp)
+trap 'rm -f "$metrics"' EXIT
+
+#
+# sizes from the linker map: the output sections and the input sections of
+# -ffunction-sections, whose name may be on a line of its own
+#
+awk -v sizes="$SIZES.raw" '
+function hex(s,    i, v) {
+	s = tolower(s)
+	sub(/^0x/, "", s)
+	v = 0
+	for (i = 1 ; i <= length(s) ; i++)
+		v = v * 16 + index("0123456789abcdef", substr(s, i, 1)) - 1
+	return v
+}
+function input(name, size, file) {
+	if (size == 0)
+		return
+	if (name ~ /^\.text\./) {
+		sub(/^\.text\./, "", name)
+		print size, name > sizes
+	}
+	sub(/.*\//, "", file)
+	sub(/\(.*/, "", file)
+	if (name ~ /^\.text/ || section == ".text")
+		text[file] += size
+}
+/^Linker script and memory map/ { inMap = 1; next }
+!inMap { next }
+/^\.[a-zA-Z_.]+[ \t]+0x[0-9a-f]+[ \t]+0x[0-9a-f]+/ {
+	section = $1
+	out[section] = hex($3)
+	next
+}
+/^\.[a-zA-Z_.]+$/ { section = pendingOut = $1; next }
+pendingOut != "" {
+	if ($1 ~ /^0x/ && $2 ~ /^0x/)
+		out[pendingOut] = hex($2)
+	pendingOut = ""
+	next
+}
+pending != "" {
+	if ($1 ~ /^0x/ && $2 ~ /^0x/)
+		input(pending, hex($2), $3)
+	pending = ""
+	next
+}
+/^ \.[^ \t]+$/ { pending = $1; next }
+/^ \.[^ \t]+[ \t]+0x[0-9a-f]+[ \t]+0x[0-9a-f]+/ { input($1, hex($3), $4) }
+END {
+	ram = out[".usbdescriptortable"] + out[".dmabuffers"] + out[".usbbuffers"] + out[".data"] + out[".noinit"] + out[".bss"]
+	print "size.text", out[".text"] + 0
+	print "size.data", out[".data"] + 0
+	print "size.bss", out[".bss"] + 0
+	print "size.flash", out[".text"] + out[".ARM.exidx"] + out[".data"]
+	print "size.ram", ram
+	for (f in text)
+		print "text." f, text[f]
+}' "$map" > "$metrics"
+
+# function sizes by demangled name without the parameters, overloads add up
+touch "$SIZES.raw"
+awk '{ print $2 }' "$SIZES.raw" | $CXXFILT | sed 's/(.*//' | paste -d ' ' - "$SIZES.raw" |
+	awk '{ size[$1] += $2 } END { for (f in size) print size[f], f }' | sort -rn > "$SIZES"
+rm -f "$SIZES.raw"
+awk '{ print "func." $2, $1 }' "$SIZES" >> "$metrics"
+
+if [ ! -s "$SIZES" ]; then
+	echo "no function sizes in $map, is it a map of a -ffunction-sections build?" >&2
+	exit 2
+fi
+
+# the median cpu time of three runs, in ns
+if ! "$bench" --benchmark_repetitions=3 --benchmark_min_time=0.2 |
+	awk 'NR > 1 { print "bench." $1, $4 }' >> "$metrics"; then
+	echo "$bench failed" >&2
+	exit 2
+fi
+
+#
+# compare: "<metric> <baseline value or -> <tolerance in %>"
+#
+if [ $update -eq 1 ]; then
+	awk 'NR == FNR { cur[$1] = $2; next }
+	     /^#/ || NF < 3 { print; next }
+	     { printf "%-40s %10s %5s\n", $1, ($1 in cur) ? cur[$1] : $2, $3 }' "$metrics" "$BASELINE" > "$BASELINE.new" &&
+		mv "$BASELINE.new" "$BASELINE"
+	echo "updated $BASELINE"
+	exit 0
+fi
+
+awk 'BEGIN { printf "%-40s %10s %10s %8s\n", "metric", "baseline", "current", "delta" }
+     NR == FNR { cur[$1] = $2; next }
+     /^#/ || NF < 3 { next }
+     {
+	name = $1; base = $2; tol = $3
+	if (!(name in cur)) {
+		printf "%-40s %10s %10s %8s  MISSING\n", name, base, "-", ""
+		missing++
+		next
+	}
+	if (base == "-") {
+		printf "%-40s %10s %10s %8s  no baseline, not checked\n", name, base, cur[name], ""
+		unarmed++
+		next
+	}
+	delta = base ? (cur[name] - base) * 100 / base : 0
+	status = ""
+	if (cur[name] > base * (1 + tol / 100)) {
+		status = "REGRESSION (> " tol "%)"
+		failed++
+	} else if (cur[name] < base * (1 - tol / 100))
+		status = "improved, update the baseline"
+	printf "%-40s %10s %10s %+7.1f%%  %s\n", name, base, cur[name], delta, status
+     }
+     END {
+	if (unarmed)
+		printf "\n%d metric(s) without a baseline are not checked yet, record them with \"make perf-baseline\"\n", unarmed
+	if (missing)
+		printf "\n*** %d metric(s) without a current value, remove them from the baseline ***\n", missing
+	if (failed)
+		printf "\n*** %d performance regression(s) against the baseline ***\n", failed
+	if (failed || missing)
+		exit 1
+     }' "$metrics" "$BASELINE"
@@ -0,0 +1,94 @@
+#!/bin/bash
+#
+# Copyright (c) 2020-2022 by Thomas König <tom@faircoin.world>
+#
+# usbsweep.sh is part of Fasito, the FairCoin signature token.
+#
+# Fasito is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# Fasito is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with Fasito, see file COPYING.
+# If not, see <http://www.gnu.org/licenses/>.
+#
+
+#
+# Sweeps the USB buffer settings against a real token: every setting is built,
+# flashed with teensy_loader_cli and loaded with fasito-load in a closed loop
+# that keeps -c requests in flight, without a block schedule. The settings
+# are sorted by the total request rate.
+# The token keeps its NVRam across the updates and must be initialised.
+#
+# usage: usbsweep.sh -d <device> -p <PIN> [-t <seconds>] [-c <in flight>] [<buffers>:<tx limit>[:<packet size>] ...]
+#
+# e.g. perf/usbsweep.sh -d /dev/ttyACM0 -p 123456 -c 8 12:8 16:12 20:16 24:20
+#
+
+LOADER=${LOADER:-teensy_loader_cli --mcu=mk20dx256 -w -s}
+LOAD=${LOAD:-./fasito-load}
+
+device=
+pin=
+seconds=10
+inFlight=8
+
+usage() {
+	echo "usage: $0 -d <device> -p <PIN> [-t <seconds>] [-c <in flight>] [<buffers>:<tx limit>[:<packet size>] ...]" >&2
+	exit 2
+}
+
+while getopts d:p:t:c: o; do
+	case $o in
+	d) device=$OPTARG ;;
+	p) pin=$OPTARG ;;
+	t) seconds=$OPTARG ;;
+	c) inFlight=$OPTARG ;;
+	*) usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+
+[ -n "$device" ] && [ -n "$pin" ] && [ -x "$LOAD" ] || usage
+[ $# -gt 0 ] || set -- 12:8 16:8 16:12 20:12 20:16 24:16 24:20
+
+results=$(mktemp)
+trap 'rm -f "$results"' EXIT
+
+for setting in "$@"; do
+	IFS=: read -r buffers limit size <<< "$setting"
+	size=${size:-64}
+
+	echo "=== $buffers buffers, tx limit $limit, $size byte packets" >&2
+	make clean-build >/dev/null
+	if ! make Fasito.hex USB_BUFFERS="$buffers" USB_TX_LIMIT="$limit" USB_PACKET_SIZE="$size" >/dev/null; then
+		echo "$setting: build failed, over USB_RAM_BUDGET?" >&2
+		continue
+	fi
+
+	# -s reboots the running token into the bootloader, wait for its port to come back
+	$LOADER Fasito.hex || exit 2
+	for i in $(seq 50); do
+		[ -c "$device" ] && break
+		sleep 0.2
+	done
+	sleep 1
+
+	# closed loop, a new NONCE/PARTSIG round whenever fewer than -c requests
+	# are outstanding: the sum of req/s over the commands (ROUND is NONCE +
+	# PARTSIG) and the worst p99 latency
+	$LOAD -d "$device" -p "$pin" -c "$inFlight" -b 0 -m 100 -t "$seconds" |
+		awk -v s="$setting" '$1 ~ /^[A-Z]+$/ && $1 != "ROUND" && NF >= 9 { rate += $4; if ($7 > p99) p99 = $7 }
+		                     END { printf "%-12s %10.1f %10d\n", s, rate, p99 }' >> "$results"
+done
+
+make clean-build >/dev/null
+
+printf "%-12s %10s %10s\n" "setting" "req/s" "p99 us"
+sort -k2 -rn "$results"
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * bench.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* On-device benchmark of the crypto primitives and the hex helpers, compiled in with ENABLE_BENCH.
+ * Every primitive runs against a throwaway key, the provisioned slots are never used.
+ */
+
+#ifdef ENABLE_BENCH
+
+#include "Arduino.h"
+#include <secp256k1.h>
+#include <secp256k1_schnorr.h>
+#include <secp256k1_ecdh.h>
+
+#include "utils.h"
+#include "opstats.h"
+#include "bench.h"
+
+extern secp256k1_context *ctx;
+
+enum {
+    BENCH_SCHNORR,
+    BENCH_ECDSA,
+    BENCH_NONCE,
+    BENCH_PARTSIG,
+    BENCH_ECDH,
+    BENCH_PUBKEY_CREATE,
+    BENCH_PARSE_HEX,
+    BENCH_ENCODE_HEX,
+    NUM_BENCH
+};
+
+static const char *benchNames[NUM_BENCH] = {
+        "SCHNORR          ",
+        "ECDSA            ",
+        "NONCE            ",
+        "PARTSIG          ",
+        "ECDH             ",
+        "pubkey_create    ",
+        "parseHex (32)    ",
+        "encodeHex (32)   ",
+};
+
+typedef struct BenchData {
+    uint8_t key[32];
+    uint8_t hash[32];
+    uint8_t privateNonce[32];
+    secp256k1_pubkey pub;
+    secp256k1_pubkey publicNonce;
+    char    hex[65];
+} BenchData;
+
+static bool runOnce(const uint8_t bench, BenchData *d)
+{
+    uint8_t out[74];
+
+    switch (bench) {
+    case BENCH_SCHNORR:
+        return secp256k1_schnorr_sign(ctx, out, d->hash, d->key, secp256k1_nonce_function_rfc6979, NULL);
+    case BENCH_ECDSA: {
+        secp256k1_ecdsa_signature sig;
+        size_t sigLen = 73;
+        return secp256k1_ecdsa_sign(ctx, &sig, d->hash, d->key, NULL, NULL) &&
+               secp256k1_ecdsa_signature_serialize_der(ctx, out, &sigLen, &sig);
+    }
+    case BENCH_NONCE:
+        return secp256k1_schnorr_generate_nonce_pair(ctx, &d->publicNonce, d->privateNonce, d->hash, d->key, NULL, d->hash);
+    case BENCH_PARTSIG:
+        return secp256k1_schnorr_partial_sign(ctx, out, d->hash, d->key, &d->publicNonce, d->privateNonce) > 0;
+    case BENCH_ECDH:
+        return secp256k1_ecdh(ctx, out, &d->pub, d->key);
+    case BENCH_PUBKEY_CREATE:
+        return secp256k1_ec_pubkey_create(ctx, &d->pub, d->key);
+    case BENCH_PARSE_HEX:
+        return parseHex(out, d->hex, 32);
+    case BENCH_ENCODE_HEX: {
+        /* into RAM, printing would time the USB transfer */
+        char hex[65];
+        encodeHex(hex, d->hash, 32);
+        return hex[0] != 0;
+    }
+    }
+
+    return false;
+}
+
+static void sortCycles(uint32_t *cycles, const uint8_t n)
+{
+    uint8_t i, j;
+
+    for (i = 1 ; i < n ; i++) {
+        const uint32_t c = cycles[i];
+        for (j = i ; j > 0 && cycles[j - 1] > c ; j--)
+            cycles[j] = cycles[j - 1];
+        cycles[j] = c;
+    }
+}
+
+bool runBenchmark(const uint8_t iterations)
+{
+    const uint8_t seed[] = {"Fasito - BENCH"};
+    uint32_t cycles[MAX_BENCH_ITERATIONS];
+    BenchData d;
+    uint8_t bench, i;
+
+    if (!iterations || iterations > MAX_BENCH_ITERATIONS)
+        return false;
+
+    memset(&d, 0, sizeof(d));
+    if (!secp256k1_hash_sha256(ctx, d.key, seed, sizeof(seed)) ||
+        !secp256k1_hash_sha256(ctx, d.hash, d.key, 32) ||
+        !secp256k1_ec_pubkey_create(ctx, &d.pub, d.key) ||
+        !secp256k1_schnorr_generate_nonce_pair(ctx, &d.publicNonce, d.privateNonce, d.hash, d.key, NULL, d.hash))
+        return false;
+
+    encodeHex(d.hex, d.hash, 32);
+
+    Serial.print("BENCH: "); Serial.print(iterations); Serial.print(" iterations at ");
+    Serial.print(F_CPU_ACTUAL / 1000000); Serial.println(" MHz");
+
+    for (bench = 0 ; bench < NUM_BENCH ; bench++) {
+        for (i = 0 ; i < iterations ; i++) {
+            const uint32_t start = cycleCount();
+            const bool fOK = runOnce(bench, &d);
+            cycles[i] = cycleCount() - start;
+
+            if (!fOK)
+                return false;
+        }
+
+        sortCycles(cycles, iterations);
+
+        const uint32_t min = cycles[0], median = cycles[iterations / 2], max = cycles[iterations - 1];
+        char line[160];
+        sprintf(line, "%s: min %lu, median %lu, max %lu cycles (%lu / %lu / %lu us)", benchNames[bench],
+                (unsigned long)min, (unsigned long)median, (unsigned long)max,
+                (unsigned long)CYCLES_TO_US(min), (unsigned long)CYCLES_TO_US(median), (unsigned long)CYCLES_TO_US(max));
+        Serial.println(line);
+    }
+
+    memset(&d, 0, sizeof(d));
+    return true;
+}
+
+#endif
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * clock.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Arduino.h"
+#include "clock.h"
+
+#if defined(ENABLE_CLOCK_SCALING) && !defined(FASITO_EMU)
+
+#if F_CPU != 144000000 || F_BUS != 48000000 || F_MEM != 24000000
+#error "clock scaling needs F_CPU=144000000, F_BUS=48000000 and F_MEM=24000000"
+#endif
+
+/* 144 MHz / 3 = 48 MHz, the lowest core clock that is still a multiple of F_BUS */
+#define IDLE_DIVIDER 3
+
+uint32_t clockBoosts = 0;
+
+static void setCoreDivider(const uint32_t divider)
+{
+    const uint32_t f = F_PLL / divider;
+
+    if (f == F_CPU_ACTUAL)
+        return;
+
+    __disable_irq();
+    const uint32_t reload = SYST_RVR + 1;
+    const uint32_t elapsed = reload - 1 - SYST_CVR;
+
+    /* bus 144 / 3 MHz, flash 144 / 6 MHz, see mk20dx128.c */
+    SIM_CLKDIV1 = SIM_CLKDIV1_OUTDIV1(divider - 1) | SIM_CLKDIV1_OUTDIV2(2) | SIM_CLKDIV1_OUTDIV4(5);
+
+    /* SysTick runs from the core clock: restart the current ms at the new
+       rate and round the part of it that already elapsed */
+    SYST_RVR = (f / 1000) - 1;
+    SYST_CVR = 0;
+    if (elapsed >= reload / 2)
+        systick_millis_count++;
+
+    F_CPU_ACTUAL = f;
+    __enable_irq();
+}
+
+void clockBoost()
+{
+    if (F_CPU_ACTUAL != F_CPU)
+        clockBoosts++;
+
+    setCoreDivider(1);
+}
+
+void clockIdle()
+{
+    setCoreDivider(IDLE_DIVIDER);
+}
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * clock.h is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_CLOCK_H_
+#define SRC_CLOCK_H_
+
+#include <stdint.h>
+
+/*
+ * With ENABLE_CLOCK_SCALING (make CLOCKSCALE=1) the PLL runs at F_CPU = 144 MHz
+ * and only the core clock divider changes: crypto commands run at 144 MHz, the
+ * token idles at 48 MHz. Bus, flash and USB clocks stay where they are.
+ */
+#if defined(ENABLE_CLOCK_SCALING) && !defined(FASITO_EMU)
+extern void clockBoost();
+extern void clockIdle();
+extern uint32_t clockBoosts;
+#else
+static inline void clockBoost() {}
+static inline void clockIdle() {}
+#endif
+
+#endif /* SRC_CLOCK_H_ */
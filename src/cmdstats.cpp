@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * cmdstats.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Arduino.h"
+#include "commands.h"
+#include "cmdstats.h"
+
+static CommandStats commandStats[MAX_COMMANDS];
+static uint32_t errorCount[NUM_ERRORS + 1];
+
+static uint8_t latencyBucket(const uint32_t us)
+{
+    const uint8_t bucket = us ? 32 - __builtin_clz(us) : 0;
+
+    return bucket < NUM_LATENCY_BUCKETS ? bucket : NUM_LATENCY_BUCKETS - 1;
+}
+
+/* upper bound of the bucket containing the given percentile */
+static uint32_t percentile(const CommandStats *s, const uint8_t pct)
+{
+    const uint32_t rank = (uint32_t)(((uint64_t)s->count * pct + 99) / 100);
+    uint32_t n = 0;
+    uint8_t i;
+
+    for (i = 0 ; i < NUM_LATENCY_BUCKETS - 1 ; i++) {
+        n += s->buckets[i];
+        if (n >= rank)
+            return 1UL << i;
+    }
+
+    return s->max;
+}
+
+void recordCommand(uint8_t index, uint32_t us, bool fOK)
+{
+    if (index >= MAX_COMMANDS)
+        return;
+
+    CommandStats *s = &commandStats[index];
+
+    s->count++;
+    if (!fOK)
+        s->errors++;
+    if (us > s->max)
+        s->max = us;
+    s->buckets[latencyBucket(us)]++;
+}
+
+void recordError(uint8_t errorNo)
+{
+    errorCount[errorNo < NUM_ERRORS ? errorNo : E_OTHER]++;
+}
+
+void resetCommandStats()
+{
+    memset(commandStats, 0, sizeof(commandStats));
+    memset(errorCount, 0, sizeof(errorCount));
+}
+
+void printCommandStats()
+{
+    char line[160];
+    uint8_t i, j;
+
+    for (i = 0 ; i < numCommands && i < MAX_COMMANDS ; i++) {
+        const CommandStats *s = &commandStats[i];
+
+        if (!s->count)
+            continue;
+
+        sprintf(line, "%-7s: count %lu, errors %lu, p50 < %lu us, p99 < %lu us, max %lu us", commands[i].command,
+                (unsigned long)s->count, (unsigned long)s->errors, (unsigned long)percentile(s, 50),
+                (unsigned long)percentile(s, 99), (unsigned long)s->max);
+        Serial.println(line);
+
+        Serial.print("         hist");
+        for (j = 0 ; j < NUM_LATENCY_BUCKETS ; j++) {
+            Serial.print(j ? "," : " ");
+            Serial.print(s->buckets[j]);
+        }
+        Serial.println();
+    }
+
+    for (i = 0 ; i <= NUM_ERRORS ; i++) {
+        if (!errorCount[i])
+            continue;
+
+        sprintf(line, "Error %2u: count %lu (%s)", i, (unsigned long)errorCount[i], i < NUM_ERRORS ? errorStrings[i] : "other");
+        Serial.println(line);
+    }
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * cmdstats.h is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_CMDSTATS_H_
+#define SRC_CMDSTATS_H_
+
+#include <stdint.h>
+
+#include "fasito_error.h"
+
+/* upper limit of entries in commands[] */
+#define MAX_COMMANDS            36
+
+/* bucket 0: < 1 us, bucket n: 2^(n-1) .. 2^n - 1 us, the last bucket is open ended (>= 4.2 s) */
+#define NUM_LATENCY_BUCKETS     24
+
+/* fasitoErrorStr() errors without an error code */
+#define E_OTHER                 NUM_ERRORS
+
+/* latencies are measured from the command terminator to the final flush in us */
+typedef struct CommandStats {
+    uint32_t count;
+    uint32_t errors;
+    uint32_t max;
+    uint32_t buckets[NUM_LATENCY_BUCKETS];
+} CommandStats;
+
+extern void recordCommand(uint8_t index, uint32_t us, bool fOK);
+extern void recordError(uint8_t errorNo);
+extern void resetCommandStats();
+extern void printCommandStats();
+
+#endif /* SRC_CMDSTATS_H_ */
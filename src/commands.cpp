@@ -28,9 +28,17 @@
 #include "commands.h"
 #include "fasito_error.h"
 #include "update.h"
+#include "opstats.h"
+#include "cmdstats.h"
+#include "bench.h"
+#include "clock.h"
+#include "memstats.h"
+#include "tasks.h"
 
 #define ENOUGH_BITS_VALUE   800
 #define AUTH_REQ_LEN        41
+#define UPDATE_REQ_LEN      59
+#define MAX_FLUSH_TIMEOUT   99
 
 extern secp256k1_context *ctx;
 extern uint8_t macAddress[];
@@ -62,6 +70,8 @@ void printHelp()
     Serial.println("HELP\r\n\t- prints this help screen");
     Serial.println("VERSION\r\n\t- clears the screen and prints the version number");
     Serial.println("ECHO\r\n\t- toggles local echo (default: off)");
+    Serial.println("ENCODE <optional: HEX|BASE64>\r\n\t- sets the encoding of signatures, nonces, keys and hashes in replies and arguments until LOGIN, LOGOUT or the port is reopened (default: HEX)");
+    Serial.println("TXFLUSH <optional: timeout in ms: 0-99>\r\n\t- sets how long partial output waits before it is sent, 0: only full packets and the end of each reply (default: 5)");
     Serial.println("LOGIN <PIN>\r\n\t- logs into Fasito");
     Serial.println("LOGOUT\r\n\t- logs out from Fasito");
     Serial.println("CHGPIN <old PIN> <new PIN>\r\n\t- changes the user PIN");
@@ -82,7 +92,15 @@ void printHelp()
     Serial.println("SNONCE <key index: 0-" NUM_PRIVATE_KEYS_STR "> <sha256 hashToSign> <sha256 randomData>\r\n\t- creates a new nonce pair, stores the private part on the device and prints out the public part");
     Serial.println("CLRPOOL\r\n\t- clears the nonce pool");
     Serial.println("ECDH <index: 0-" NUM_PRIVATE_KEYS_STR "> <DER public key>\r\n\t- creates a shared secret for a local private key and the supplied public key");
+    Serial.println("UPDATE <image size: 0x12345678> <admin signature>\r\n\t- receives a binary firmware image of the given size, checks the admin signature of its update hash and installs it.\r\n\t  update hash: sha256d(\"Fasito - UPDATE\" | serial number | AUTH-Requests (2 bytes LE) | image size (4 bytes LE) | sha256(image))");
     Serial.println("DEVADM\r\n\t- list the " NUM_ADMIN_KEYS_STR " device admin public keys");
+    Serial.println("IOSTAT <optional: RESET>\r\n\t- prints timing statistics of NVRam and flash operations and USB statistics, RESET needs LOGIN");
+    Serial.println("STATS <optional: RESET>\r\n\t- prints latency histograms per command and error counters, RESET needs LOGIN");
+    Serial.println("MEMSTAT <optional: RESET>\r\n\t- prints RAM usage, the stack high-water mark and the size of the major buffers, RESET needs LOGIN");
+    Serial.println("TASKS <optional: RESET>\r\n\t- prints the runtime of the background tasks, RESET needs LOGIN");
+#ifdef ENABLE_BENCH
+    Serial.println("BENCH <iterations: 1-99>\r\n\t- measures the cycles of the crypto primitives and hex helpers with a throwaway key");
+#endif
 #ifdef ENABLE_INSCURE_FUNC
     Serial.println("DUMP\r\n\t- dumps the contents of the eeprom and internal data structurs");
     Serial.println("SETKEY <index: 0-" NUM_PRIVATE_KEYS_STR "> <CVN ID:0x12345678> <sha256 hash>\r\n\t- initialises a pre-seeded key");
@@ -105,8 +123,19 @@ void printStatus()
     Serial.print("Protection status : 0x"); Serial.print(nProtectionState, BIN); Serial.print(" (0x"); Serial.print(nProtectionState, HEX); Serial.print(")");
     Serial.print(", AUTH-Requests: "); Serial.println(nvram.resetCount);
     Serial.print("Config version    : "); Serial.println(nvram.version);
-    Serial.print("Config checksum   : "); Serial.print(nvram.checksum, HEX); Serial.println();
-    Serial.print("Nonce pool size   : "); Serial.print(NUM_NONCE_POOL); Serial.println("\r\n");
+    Serial.print("Config checksum   : "); Serial.print(nvram.coldChecksum, HEX); Serial.print("/"); Serial.print(nvram.checksum, HEX); Serial.println();
+    Serial.print("Nonce pool size   : "); Serial.println(NUM_NONCE_POOL);
+#if defined(ENABLE_CLOCK_SCALING) && !defined(FASITO_EMU)
+    Serial.print("CPU clock         : "); Serial.print(F_CPU_ACTUAL / 1000000); Serial.print(" MHz, ");
+    Serial.print(F_CPU / 1000000); Serial.print(" MHz for crypto commands ("); Serial.print(clockBoosts); Serial.println(" boosts)");
+#endif
+    printUpdateResult();
+    Serial.print("Boot time         : "); Serial.print(bootMicros); Serial.print(" us (secp256k1 context: ");
+    Serial.print(contextMicros); Serial.print(" us");
+#ifdef ENABLE_FAST_BOOT
+    Serial.print(", fast boot");
+#endif
+    Serial.println(")\r\n");
     Serial.print("User PIN          : "); Serial.print(userPINStatus[nvram.userPin.status]);
     Serial.print(" (tries left: ");     Serial.print(nvram.userPin.triesLeft); Serial.println(")\r\n");
 
@@ -127,20 +156,16 @@ void initNonceStorage()
     memset(singleNonce, 0, sizeof(singleNonce));
 }
 
-static bool verifyAdminSignature(const char *sig, uint8_t *hash)
+/* EC-Schnorr signatures size is 64 bytes */
+static bool parseAdminSignature(uint8_t *schnorrSig, const char *sig)
 {
-    /* EC-Schnorr signatures size is 64 bytes */
-    if (!sig || !*sig || strlen(sig) != 64 * 2 ) {
-        return false;
-    }
+    return sig && *sig && parseValue(schnorrSig, sig, 64);
+}
 
+static bool verifyAdminSignature(const uint8_t *schnorrSig, const uint8_t *hash)
+{
     Serial.println("checking signature.");
 
-    uint8_t schnorrSig[64];
-    size_t sigLen = strlen(sig) / 2;
-    if (!parseHex(schnorrSig, sig, sigLen))
-        return false;
-
     uint8_t i;
     bool verified = false;
     for (i = 0 ; i < NUM_ADMIN_KEYS ; i++) {
@@ -197,15 +222,15 @@ static bool createAuthorisationRequest(const uint8_t type, const uint8_t *privDa
         return fasitoErrorStr("could not serialise public key.");
 
     Serial.println("AUTHREQ = {");
-    Serial.print("  \"data\": \""); printHex(data, AUTH_REQ_LEN); Serial.println("\",");
-    Serial.print("  \"hash\": \""); printHex(requestHash, 32); Serial.println("\",");
-    Serial.print("  \"pubKey\": \""); printHex(pubKey, keyLen); Serial.println("\",");
-    Serial.print("  \"signature\": \""); printHex(sig, 64); Serial.println("\"\r\n}");
+    Serial.print("  \"data\": \""); printValue(data, AUTH_REQ_LEN); Serial.println("\",");
+    Serial.print("  \"hash\": \""); printValue(requestHash, 32); Serial.println("\",");
+    Serial.print("  \"pubKey\": \""); printValue(pubKey, keyLen); Serial.println("\",");
+    Serial.print("  \"signature\": \""); printValue(sig, 64); Serial.println("\"\r\n}");
 
     return true;
 }
 
-static bool getIndexParameter(const char *indexChar, uint8_t &index, uint8_t maxEntries)
+bool getIndexParameter(const char *indexChar, uint8_t &index, uint8_t maxEntries)
 {
     /* check the index parameter */
     size_t len = strlen(indexChar);
@@ -227,12 +252,10 @@ static bool getIndexParameter(const char *indexChar, uint8_t &index, uint8_t max
     return true;
 }
 
-static bool getHexParameter(const char *t, uint8_t *hash, size_t outLen)
+/* hex, or base64 if the session has set ENCODE BASE64 */
+bool getHexParameter(const char *t, uint8_t *hash, size_t outLen)
 {
-    if (!t || strlen(t) != outLen * 2)
-        return fasitoError(E_INVALID_HEX_PARAM);
-
-    if (!parseHex(hash, t, outLen))
+    if (!parseValue(hash, t, outLen))
         return fasitoError(E_INVALID_HEX_PARAM);
 
     return true;
@@ -320,7 +343,7 @@ static bool cmdInitFasito(const char **tokens, const uint8_t nTokens)
      */
     uint8_t derKey[65];
     for (i = 0; i < NUM_ADMIN_KEYS ; i++) {
-        if (strlen(tokens[i + 1]) != 130 || !parseHex(derKey, tokens[i + 1], 65))
+        if (!parseValue(derKey, tokens[i + 1], 65))
             return fasitoError(E_INVALID_ADMIN_PUB_KEY, i + 1);
 
         if (!secp256k1_ec_pubkey_parse(ctx, &nvram.adminPublicKey[i], derKey, 65)) {
@@ -333,7 +356,7 @@ static bool cmdInitFasito(const char **tokens, const uint8_t nTokens)
      * and as device verification private key
      */
     uint8_t devicePrivateKey[32];
-    if (strlen(tokens[4]) != 64 || !parseHex(devicePrivateKey, tokens[4], 32) || !secp256k1_ec_seckey_verify(ctx, devicePrivateKey))
+    if (!parseValue(devicePrivateKey, tokens[4], 32) || !secp256k1_ec_seckey_verify(ctx, devicePrivateKey))
         return fasitoError(E_INVALID_DEVICE_VERFICATION_KEY);
 
     PrivateKey *pk = nvram.privateKey;
@@ -362,6 +385,9 @@ static bool cmdCheckPin(const char **tokens, const uint8_t nTokens)
     if (userPin->status == userPin->NOT_SET)
         return fasitoError(E_NO_PIN);
 
+    /* every session starts in hex */
+    encoding = ENC_HEX;
+
     if (nTokens != 1 || !comparePins(userPin, tokens[0])) {
         fasitoError(E_INVALID_PIN, --userPin->triesLeft);
         loggedIn = false;
@@ -370,13 +396,13 @@ static bool cmdCheckPin(const char **tokens, const uint8_t nTokens)
             Serial.println("The token is now locked.");
         }
 
-        writeEEPROM(&nvram);
+        writeHotEEPROM(&nvram);
         return false;
     }
 
     if (userPin->triesLeft != MAX_PIN_TRIES) {
         userPin->triesLeft = MAX_PIN_TRIES;
-        writeEEPROM(&nvram);
+        writeHotEEPROM(&nvram);
     }
 
     loggedIn = true;
@@ -390,6 +416,7 @@ static bool cmdLogout(const char **tokens, const uint8_t nTokens)
 {
     Serial.println("You have been logged out.");
     loggedIn = false;
+    encoding = ENC_HEX;
     return true;
 }
 
@@ -422,7 +449,7 @@ static bool cmdChangePin(const char **tokens, const uint8_t nTokens)
     memset(up->pin, 0, MAX_PIN_LENGTH + 1);
     strcpy(up->pin, pin);
 
-    writeEEPROM(&nvram);
+    writeHotEEPROM(&nvram);
 
     Serial.println("PIN successfully changed.");
     return true;
@@ -460,7 +487,9 @@ static bool cmdResetPin(const char **tokens, const uint8_t nTokens)
     if (nTokens != 2)
         return true;
 
-    if (!verifyAdminSignature(tokens[1], requestHash))
+    uint8_t adminSig[64];
+    if (!parseAdminSignature(adminSig, tokens[1]) ||
+        !verifyAdminSignature(adminSig, requestHash))
         return fasitoError(E_INVALID_ADMIN_SIGNATURE);
 
     nvram.userPin.status = UserPIN::SET;
@@ -507,7 +536,9 @@ static bool cmdResetKey(const char **tokens, const uint8_t nTokens)
     if (nTokens != 2)
         return true;
 
-    if (!verifyAdminSignature(tokens[1], requestHash))
+    uint8_t adminSig[64];
+    if (!parseAdminSignature(adminSig, tokens[1]) ||
+        !verifyAdminSignature(adminSig, requestHash))
         return fasitoError(E_INVALID_ADMIN_SIGNATURE);
 
     p.nodeId = 0;
@@ -539,20 +570,18 @@ static bool cmdEraseToken(const char **tokens, const uint8_t nTokens)
     if (nTokens != 1)
         return true;
 
-    if (!verifyAdminSignature(tokens[0], requestHash))
+    uint8_t adminSig[64];
+    if (!parseAdminSignature(adminSig, tokens[0]) ||
+        !verifyAdminSignature(adminSig, requestHash))
         return fasitoError(E_INVALID_ADMIN_SIGNATURE);
 
     /* sign back the hash of the incoming admin signature */
-    uint8_t adminSig[64];
-    if (!parseHex(adminSig, tokens[0], 64))
-        return false;
-
     uint8_t sig[64], hashToSign[32];
     if (!createDeviceSignature(sig, hashToSign, adminSig, 64))
         return false;
 
-    Serial.print("PROOFHASH: "); printHex(hashToSign, 32, true);
-    Serial.print("PROOFSIG : "); printHex(sig, 64, true);
+    Serial.print("PROOFHASH: "); printValue(hashToSign, 32, true);
+    Serial.print("PROOFSIG : "); printValue(sig, 64, true);
 
     memset(&nvram, 0, sizeof(FasitoNVRam));
     nvram.version = CONFIG_VERSION;
@@ -575,6 +604,51 @@ static bool cmdEcho(const char **tokens, const uint8_t nTokens)
     return true;
 }
 
+/**
+ * ENCODE <optional: HEX|BASE64>
+ */
+static bool cmdEncode(const char **tokens, const uint8_t nTokens)
+{
+    if (nTokens > 1)
+        return fasitoError(E_INVALID_ARGUMENTS);
+
+    if (nTokens == 1) {
+        uint8_t i;
+        for (i = 0 ; i < NUM_ENCODINGS && strcmp(tokens[0], encodingNames[i]) ; i++) ;
+
+        if (i == NUM_ENCODINGS)
+            return fasitoError(E_INVALID_ARGUMENTS);
+
+        encoding = i;
+    }
+
+    Serial.print("encoding is ");
+    Serial.println(encodingNames[encoding]);
+    return true;
+}
+
+/**
+ * TXFLUSH <optional: timeout in ms: 0-99>
+ */
+static bool cmdTxFlush(const char **tokens, const uint8_t nTokens)
+{
+    if (nTokens > 1)
+        return fasitoError(E_INVALID_ARGUMENTS);
+
+    if (nTokens == 1) {
+        uint8_t ms = 0;
+        if (!getIndexParameter(tokens[0], ms, MAX_FLUSH_TIMEOUT))
+            return false;
+
+        Serial.setFlushTimeout(ms);
+    }
+
+    Serial.print("flush timeout is ");
+    Serial.print(Serial.flushTimeout());
+    Serial.println(" ms");
+    return true;
+}
+
 /**
  * HELP
  */
@@ -687,7 +761,7 @@ static bool doSign(const char **tokens, const uint8_t nTokens, bool schnorr)
         if (!secp256k1_schnorr_sign(ctx, sig, hashToSign, p->key, secp256k1_nonce_function_rfc6979, NULL))
             return fasitoError(E_COULD_NOT_CREATE_SCHNORR_SIG);
 
-        printHex(sig, 64, true);
+        printValue(sig, 64, true);
 
         return true;
     } else {
@@ -702,7 +776,7 @@ static bool doSign(const char **tokens, const uint8_t nTokens, bool schnorr)
             return fasitoErrorStr("secp256k1_ecdsa_signature_serialize_der failed");
         }
 
-        printHex(der, sigLen, true);
+        printValue(der, sigLen, true);
 
         return true;
     }
@@ -766,7 +840,7 @@ static bool cmdCreateNonces(const char **tokens, const uint8_t nTokens)
     memcpy(savedNonces[nonceCursor], privateNonce, 32);
     if (nonceCursor < 10)
         Serial.print("0");;
-    Serial.print(nonceCursor); Serial.print(" "); printHex(publicNonce.data, 64, true);
+    Serial.print(nonceCursor); Serial.print(" "); printValue(publicNonce.data, 64, true);
 
     if (nonceCursor++ >= NUM_NONCE_POOL - 1)
         nonceCursor = 0;
@@ -785,7 +859,7 @@ static bool cmdCreateSingleNonce(const char **tokens, const uint8_t nTokens)
     if (!doCreateNoncePair(tokens, nTokens, singleNonce, &publicNonce))
         return false;
 
-    printHex(publicNonce.data, 64, true);
+    printValue(publicNonce.data, 64, true);
     return true;
 }
 
@@ -825,7 +899,7 @@ static bool cmdCreatePartialSchnorrSignature(const char **tokens, const uint8_t
     if (secp256k1_schnorr_partial_sign(ctx, partialSig, hashToSign, p->key, &othersPublicNonces, savedNonces[nonceSlot]) < 1)
         return fasitoErrorStr("secp256k1_schnorr_partial_sign failed");
 
-    printHex(partialSig, 64, true);
+    printValue(partialSig, 64, true);
 
     return true;
 }
@@ -854,13 +928,13 @@ static bool cmdGetPublicKey(const char **tokens, const uint8_t nTokens)
     if (!secp256k1_ec_pubkey_serialize(ctx, pubKey, &keyLen, &pub, SECP256K1_EC_UNCOMPRESSED))
         return fasitoErrorStr("could not serialise public key.");
 
-    printHex(pubKey, keyLen, true);
+    printValue(pubKey, keyLen, true);
 
     keyLen = 74;
     if (!secp256k1_ec_pubkey_serialize(ctx, pubKey, &keyLen, &pub, SECP256K1_EC_COMPRESSED))
         return fasitoErrorStr("could not serialise compressed public key.");
 
-    printHex(pubKey, keyLen, true);
+    printValue(pubKey, keyLen, true);
 
     return true;
 }
@@ -903,25 +977,81 @@ static bool cmdCreateKeyProof(const char **tokens, const uint8_t nTokens)
         return fasitoErrorStr("could not serialise public key.");
 
     Serial.println("KEYPROOF = {");
-    Serial.print("  \"proofData\": \""); printHex(data, sizeof(data)); Serial.println("\",");
-    Serial.print("  \"derPubKey\": \""); printHex(derKey, keyLen); Serial.println("\",");
-    Serial.print("  \"rawPubKey\": \""); printHex(&data[4], 64); Serial.println("\",");
-    Serial.print("  \"hash\": \""); printHex(hashToSign, 32); Serial.println("\",");
-    Serial.print("  \"signature\": \""); printHex(sig, 64); Serial.println("\"\r\n}");
+    Serial.print("  \"proofData\": \""); printValue(data, sizeof(data)); Serial.println("\",");
+    Serial.print("  \"derPubKey\": \""); printValue(derKey, keyLen); Serial.println("\",");
+    Serial.print("  \"rawPubKey\": \""); printValue(&data[4], 64); Serial.println("\",");
+    Serial.print("  \"hash\": \""); printValue(hashToSign, 32); Serial.println("\",");
+    Serial.print("  \"signature\": \""); printValue(sig, 64); Serial.println("\"\r\n}");
 
     return true;
 }
 
 /**
- * UPDATE <schnorr signature>
+ * The admin signs a hash over the image hash, the serial number and the reset
+ * counter rather than the image hash itself, so neither an AUTHREQ signature
+ * nor the signature of an earlier update can be replayed.
+ */
+static bool createUpdateRequestHash(const uint32_t imageSize, const uint8_t *imageHash, uint8_t *requestHash)
+{
+    static const char seed[] = "Fasito - UPDATE";
+    uint8_t data[UPDATE_REQ_LEN];
+
+    memcpy(data, seed, 15);
+    memcpy(&data[15], macAddress, 6);
+    memcpy(&data[21], &nvram.resetCount, 2);
+    memcpy(&data[23], &imageSize, 4);
+    memcpy(&data[27], imageHash, 32);
+
+    return secp256k1_hash_sha256d(ctx, requestHash, data, UPDATE_REQ_LEN);
+}
+
+/**
+ * UPDATE <image size: 0x12345678> <admin signature of the update hash>
  */
 static bool cmdUpdateFirmware(const char **tokens, const uint8_t nTokens)
 {
+    if (nTokens != 2)
+        return fasitoError(E_INVALID_ARGUMENTS);
+
+    if (!tokens[0] || strlen(tokens[0]) != 10)
+        return fasitoError(E_INVALID_ARGUMENTS);
+
+    uint8_t sizeBytes[4];
+    if (!parseHex(sizeBytes, &tokens[0][2], 4))
+        return fasitoError(E_INVALID_ARGUMENTS);
+
+    reverseBytes(sizeBytes, 4);
+    const uint32_t imageSize = *(uint32_t *)sizeBytes;
+
+    /* the tokens live in inputBuffer, which receives the image */
     uint8_t sig[64];
-    if (!getHexParameter(tokens[0], sig, 64))
+    if (!parseAdminSignature(sig, tokens[1]))
+        return fasitoError(E_INVALID_ADMIN_SIGNATURE);
+
+    uint8_t imageHash[32];
+    if (!receiveFirmware(imageSize, imageHash))
         return false;
 
-    return updateFirmware();
+    uint8_t requestHash[32];
+    if (!createUpdateRequestHash(imageSize, imageHash, requestHash))
+        return fasitoError(E_COULD_NOT_CREATE_HASH);
+
+    Serial.print("IMAGEHASH: "); printValue(imageHash, 32, true);
+    Serial.print("UPDATEHASH: "); printValue(requestHash, 32, true);
+
+    if (!verifyAdminSignature(sig, requestHash))
+        return fasitoError(E_INVALID_ADMIN_SIGNATURE);
+
+    /* the signature is used up */
+    ++nvram.resetCount;
+    writeHotEEPROM(&nvram);
+
+    Serial.println("Committing new firmware. The token restarts when done.");
+    Serial.flush();
+    delay(100);
+
+    commitFirmware(imageSize);
+    return true;
 }
 
 /**
@@ -966,13 +1096,15 @@ static bool cmdUnsealFasito(const char **tokens, const uint8_t nTokens)
     if (nTokens != 1)
         return true;
 
-    if (!verifyAdminSignature(tokens[0], requestHash))
+    uint8_t adminSig[64];
+    if (!parseAdminSignature(adminSig, tokens[0]) ||
+        !verifyAdminSignature(adminSig, requestHash))
         return fasitoError(E_INVALID_ADMIN_SIGNATURE);
 
     Serial.println("Un-sealing this Fasito.");
 
     ++nvram.resetCount;
-    writeEEPROM(&nvram);
+    writeHotEEPROM(&nvram);
 
     return unsealDevice();
 }
@@ -990,7 +1122,7 @@ static bool cmdEcdh(const char **tokens, const uint8_t nTokens)
         return false;
 
     uint8_t derKey[65];
-    if (strlen(tokens[1]) != 130 || !parseHex(derKey, tokens[1], 65))
+    if (!parseValue(derKey, tokens[1], 65))
         return fasitoError(E_INVALID_ARGUMENTS, 1);
 
     secp256k1_pubkey pubKeyOther;
@@ -1009,7 +1141,7 @@ static bool cmdEcdh(const char **tokens, const uint8_t nTokens)
         return fasitoErrorStr("could not create secret");
     }
 
-    Serial.print("SHARED-SECRET: "); printHex(secret, 32, true);
+    Serial.print("SHARED-SECRET: "); printValue(secret, 32, true);
 
     return true;
 }
@@ -1033,12 +1165,128 @@ static bool cmdListDeviceAdminKeys(const char **tokens, const uint8_t nTokens)
             return fasitoErrorStr("could not serialise public key.");
 
         Serial.print("Device admin public key #"); Serial.print(i); Serial.print(": ");
-        printHex(pubKey, keyLen, true);
+        printValue(pubKey, keyLen, true);
     }
 
     return true;
 }
 
+/* RESET of the statistics commands clears shared state, only after LOGIN */
+static bool checkReset(const char *token)
+{
+    if (strcmp(token, "RESET"))
+        return fasitoError(E_INVALID_ARGUMENTS);
+
+    if (!loggedIn)
+        return fasitoError(E_NOT_LOGGED_IN);
+
+    return true;
+}
+
+/**
+ * IOSTAT <optional: RESET>
+ */
+static bool cmdIOStats(const char **tokens, const uint8_t nTokens)
+{
+    if (nTokens > 1)
+        return fasitoError(E_INVALID_ARGUMENTS);
+
+    if (nTokens == 1) {
+        if (!checkReset(tokens[0]))
+            return false;
+
+        resetOpStats();
+        return true;
+    }
+
+    printOpStats();
+    return true;
+}
+
+/**
+ * STATS <optional: RESET>
+ */
+static bool cmdStats(const char **tokens, const uint8_t nTokens)
+{
+    if (nTokens > 1)
+        return fasitoError(E_INVALID_ARGUMENTS);
+
+    if (nTokens == 1) {
+        if (!checkReset(tokens[0]))
+            return false;
+
+        resetCommandStats();
+        return true;
+    }
+
+    printCommandStats();
+    return true;
+}
+
+/**
+ * TASKS <optional: RESET>
+ */
+static bool cmdTasks(const char **tokens, const uint8_t nTokens)
+{
+    if (nTokens > 1)
+        return fasitoError(E_INVALID_ARGUMENTS);
+
+    if (nTokens == 1) {
+        if (!checkReset(tokens[0]))
+            return false;
+
+        resetTaskStats();
+        return true;
+    }
+
+    printTaskStats();
+    return true;
+}
+
+/**
+ * MEMSTAT <optional: RESET>
+ */
+static bool cmdMemStats(const char **tokens, const uint8_t nTokens)
+{
+    if (nTokens > 1)
+        return fasitoError(E_INVALID_ARGUMENTS);
+
+    if (nTokens == 1) {
+        if (!checkReset(tokens[0]))
+            return false;
+
+        /* repaint, the high-water mark starts over from here */
+        paintStack();
+        return true;
+    }
+
+    printMemStats();
+    return true;
+}
+
+#ifdef ENABLE_BENCH
+/**
+ * BENCH <iterations: 1-99>
+ */
+static bool cmdBench(const char **tokens, const uint8_t nTokens)
+{
+    if (nTokens != 1)
+        return fasitoError(E_INVALID_ARGUMENTS);
+
+    uint8_t iterations = 0;
+    if (!getIndexParameter(tokens[0], iterations, MAX_BENCH_ITERATIONS))
+        return false;
+
+    if (!iterations)
+        return fasitoError(E_INVALID_ARGUMENTS);
+
+    if (!runBenchmark(iterations))
+        return fasitoErrorStr("benchmark failed");
+
+    return true;
+}
+#endif
+
 #ifdef ENABLE_INSCURE_FUNC
 static bool cmdDUMP(const char **tokens, const uint8_t nTokens)
 {
@@ -1139,38 +1387,51 @@ static bool cmdSetKey(const char **tokens, const uint8_t nTokens)
 
 /* commands may not be longer than 7 (NULL terminator) characters */
 const Command commands[] = {
-        {"HELP",    cmdHelp,                             4, false},
-        {"VERSION", cmdVersion,                          7, false},
-        {"ECHO",    cmdEcho,                             4, false},
-        {"LOGIN",   cmdCheckPin,                         5, false},
-        {"LOGOUT",  cmdLogout,                           6, true },
-        {"CHGPIN",  cmdChangePin,                        6, true },
-        {"RSTPIN",  cmdResetPin,                         6, false},
-        {"NONCE",   cmdCreateNonces,                     5, true },
-        {"PARTSIG", cmdCreatePartialSchnorrSignature,    7, true },
-        {"ECDSA",   cmdEcdsaSign,                        5, true },
-        {"SCHNORR", cmdCreateSchnorrSignature,           7, true },
-        {"SEAL",    cmdSealFasito,                       4, true },
-        {"UNSEAL",  cmdUnsealFasito,                     6, true },
-        {"INFO",    cmdInfo,                             4, false },
-        {"INITKEY", cmdInitKey,                          7, true },
-        {"INIT",    cmdInitFasito,                       4, false},
-        {"ERASE",   cmdEraseToken,                       5, true },
-        {"RSTKEY",  cmdResetKey,                         6, true },
-        {"GETPBKY", cmdGetPublicKey,                     7, true },
-        {"UPDATE",  cmdUpdateFirmware,                   6, true },
-        {"SNONCE",  cmdCreateSingleNonce,                6, true },
-        {"CLRPOOL", cmdClearNoncePool,                   7, true },
-        {"KYPROOF", cmdCreateKeyProof,                   7, true },
-        {"ECDH",    cmdEcdh,                             4, true },
-        {"DEVADM",  cmdListDeviceAdminKeys,              6, false },
+        {"HELP",    cmdHelp,                             4, false, false},
+        {"VERSION", cmdVersion,                          7, false, false},
+        {"ECHO",    cmdEcho,                             4, false, false},
+        {"ENCODE",  cmdEncode,                           6, false, false},
+        {"TXFLUSH", cmdTxFlush,                          7, false, false},
+        {"LOGIN",   cmdCheckPin,                         5, false, false},
+        {"LOGOUT",  cmdLogout,                           6, true,  false},
+        {"CHGPIN",  cmdChangePin,                        6, true,  false},
+        {"RSTPIN",  cmdResetPin,                         6, false, false},
+        {"NONCE",   cmdCreateNonces,                     5, true,  true },
+        {"PARTSIG", cmdCreatePartialSchnorrSignature,    7, true,  true },
+        {"ECDSA",   cmdEcdsaSign,                        5, true,  true },
+        {"SCHNORR", cmdCreateSchnorrSignature,           7, true,  true },
+        {"SEAL",    cmdSealFasito,                       4, true,  false},
+        {"UNSEAL",  cmdUnsealFasito,                     6, true,  false},
+        {"INFO",    cmdInfo,                             4, false, false},
+        {"INITKEY", cmdInitKey,                          7, true,  true },
+        {"INIT",    cmdInitFasito,                       4, false, false},
+        {"ERASE",   cmdEraseToken,                       5, true,  false},
+        {"RSTKEY",  cmdResetKey,                         6, true,  false},
+        {"GETPBKY", cmdGetPublicKey,                     7, true,  true },
+        {"UPDATE",  cmdUpdateFirmware,                   6, true,  false},
+        {"SNONCE",  cmdCreateSingleNonce,                6, true,  true },
+        {"CLRPOOL", cmdClearNoncePool,                   7, true,  false},
+        {"KYPROOF", cmdCreateKeyProof,                   7, true,  true },
+        {"ECDH",    cmdEcdh,                             4, true,  true },
+        {"DEVADM",  cmdListDeviceAdminKeys,              6, false, false},
+        {"IOSTAT",  cmdIOStats,                          6, false, false},
+        {"STATS",   cmdStats,                            5, false, false},
+        {"MEMSTAT", cmdMemStats,                         7, false, false},
+        {"TASKS",   cmdTasks,                            5, false, false},
+#ifdef ENABLE_BENCH
+        {"BENCH",   cmdBench,                            5, false, true },
+#endif
 #if ENABLE_INSCURE_FUNC
-        {"DUMP",    cmdDUMP,                             4, false },
-        {"SETKEY",  cmdSetKey,                           6, true },
+        {"DUMP",    cmdDUMP,                             4, false, false},
+        {"SETKEY",  cmdSetKey,                           6, true,  false},
 #endif
 };
 
-const Command *getCommand(char *buf)
+const uint8_t numCommands = sizeof(commands) / sizeof(Command);
+
+static_assert(sizeof(commands) / sizeof(Command) <= MAX_COMMANDS, "increase MAX_COMMANDS in cmdstats.h");
+
+HOTRUN const Command *getCommand(char *buf)
 {
     if (!buf || !strlen(buf))
         return NULL;
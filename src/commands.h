@@ -29,6 +29,7 @@ typedef struct Command
     bool (*handler)(const char **tokens, const uint8_t nTokens);
     uint8_t len;
     bool requireLogin;
+    bool boost;         /* runs at the boost clock with ENABLE_CLOCK_SCALING */
 } Command;
 
 extern void printHelp();
@@ -36,5 +37,10 @@ extern void printVersion();
 extern void printStatus();
 extern void initNonceStorage();
 extern const Command *getCommand(char *buf);
+extern bool getIndexParameter(const char *indexChar, uint8_t &index, uint8_t maxEntries);
+extern bool getHexParameter(const char *t, uint8_t *hash, size_t outLen);
+
+extern const Command commands[];
+extern const uint8_t numCommands;
 
 #endif /* SRC_COMMANDS_H_ */
@@ -21,6 +21,7 @@
 #ifndef SRC_FASITO_H_
 #define SRC_FASITO_H_
 
+#include <stddef.h>
 #include "version.h"
 #include <secp256k1.h>
 
@@ -28,6 +29,16 @@
 #define INPUT_BUFFER_SIZE 2048
 extern char inputBuffer[];
 extern bool loggedIn;
+extern uint32_t bootMicros;
+extern uint32_t contextMicros;
+extern uint32_t contextBytes;
+
+/* command path functions that run from RAM with ENABLE_FASTRUN (make FASTRUN=1) */
+#ifdef ENABLE_FASTRUN
+#define HOTRUN FASTRUN
+#else
+#define HOTRUN
+#endif
 
 /* maximum number of arguments to commands */
 #define MAX_TOKEN            16
@@ -69,9 +80,16 @@ typedef struct PrivateKey {
     uint32_t nodeId;
     uint8_t  key[32];
     uint8_t  status;
+    uint8_t  reserved[3];
 } PrivateKey;
 
 
+/* All fields are 32-bit aligned so the FlexRAM only sees word writes.
+ * The cold region holds the key material which only changes on INIT,
+ * INITKEY, RSTKEY and ERASE. The hot region holds the PIN state and
+ * counters. Each region carries its own checksum, so updating the hot
+ * region leaves the cold region untouched.
+ */
 typedef struct FasitoNVRam {
     /* Fasito status */
     enum {
@@ -79,17 +97,22 @@ typedef struct FasitoNVRam {
         CONFIGURED
     };
 
+    /* cold region, version needs to remain the first field */
     uint8_t    version;
     uint8_t    fasitoStatus;
-
-    UserPIN    userPin;
+    uint16_t   reserved;
     PrivateKey privateKey[NUM_PRIVATE_KEYS];
     secp256k1_pubkey adminPublicKey[NUM_ADMIN_KEYS];
+    uint16_t   coldReserved;
+    uint16_t   coldChecksum;
 
-    /* checksum needs to remain the last field */
+    /* hot region, checksum needs to remain the last field */
+    UserPIN    userPin;
     uint16_t   resetCount;
     uint16_t   checksum;
 } FasitoNVRam;
 
+#define NVRAM_HOT_OFFSET offsetof(FasitoNVRam, userPin)
+#define NVRAM_HOT_SIZE   (sizeof(FasitoNVRam) - NVRAM_HOT_OFFSET)
 
 #endif /* SRC_FASITO_H_ */
@@ -46,6 +46,8 @@ enum {
     E_DUPLICATE_PRIV_KEY,
     E_COULD_NOT_CREATE_SCHNORR_SIG,
     E_COULD_NOT_PROGRAM_PROT_BITS,
+    E_LINE_TOO_LONG,
+    NUM_ERRORS
 };
 
 extern const char *errorStrings[];
@@ -26,15 +26,32 @@
 #include "commands.h"
 #include "fasito_error.h"
 #include "utils.h"
+#include "opstats.h"
+#include "cmdstats.h"
+#include "clock.h"
+#include "memstats.h"
+#include "tasks.h"
+#include "update.h"
 
 secp256k1_context *ctx = NULL;
 
 /* serial communication */
-char inputBuffer[INPUT_BUFFER_SIZE];
+/* also serves as sector buffer for firmware updates */
+char inputBuffer[INPUT_BUFFER_SIZE] __attribute__((aligned(4)));
 uint16_t inputBufferIndex = 0;
+/* the line did not fit into inputBuffer, it is answered with an error */
+static bool lineTooLong = false;
 
 uint8_t macAddress[6];
 
+/* us from the start of the core until NVRam and the secp256k1 context were ready */
+uint32_t bootMicros = 0;
+uint32_t contextMicros = 0;
+uint32_t contextBytes = 0;
+
+/* command handled by the last call of handleCommand(), NULL if none was found */
+static const Command *currentCommand = NULL;
+
 bool handleCommand();
 extern const Command *getCommand(char *buf);
 
@@ -59,21 +76,35 @@ void yield(void)
 
 void setup()
 {
+    paintStack();
+    checkUpdateResult();
+    enableCycleCounter();
     pinMode(LED, OUTPUT);
     Serial.begin(115200);
     digitalWrite(LED, HIGH);
     initNonceStorage();
 
+#ifndef ENABLE_FAST_BOOT
+    /* give a terminal time to open the port before the banner */
     delay(2000);
+#endif
     readMAC(macAddress);
+#ifndef ENABLE_FAST_BOOT
     Serial.println(CLS "\r\n");
     printVersion();
+#endif
     *inputBuffer = 0;
     inputBufferIndex = 0;
 
+    /* with fast boot the USB enumeration runs in its interrupts meanwhile */
+    clockBoost();
+    const uint32_t contextStart = micros();
+    const uint32_t heapStart = heapInUse();
     ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
     secp256k1_context_set_error_callback(ctx, custom_error_callback_fn, NULL);
     secp256k1_context_set_illegal_callback(ctx, custom_illegal_callback_fn, NULL);
+    contextMicros = micros() - contextStart;
+    contextBytes = heapInUse() - heapStart;
 
     if (!readEEPROM(&nvram)) {
         Serial.println("Error NVRam checksum error");
@@ -87,56 +118,108 @@ void setup()
         writeEEPROM(&nvram);
     }
 
+    bootMicros = micros();
+
+#ifndef ENABLE_FAST_BOOT
     Serial.println("\r\nStatus overview:");
     printStatus();
+#endif
 
+    /* ready, the LED is on while booting and handling a command */
+    checkStack(MEM_BOOT);
+    startTasks();
     digitalWrite(LED, LOW);
+    clockIdle();
 }
 
-void loop()
+static void processLine()
 {
-    int c;
+    const uint32_t start = micros();
+    bool fOK = true;
 
-    if (Serial.available() > 0) {
-        c = Serial.read();
+    digitalWrite(LED, HIGH);
+    currentCommand = NULL;
 
-        if (serialEcho) {
-            if (c == '\r') {
-                Serial.println();
-            } else {
-                char echo[2] = { 0, 0 };
-                echo[0] = c;
-                Serial.print(echo);
-            }
+    inputBuffer[inputBufferIndex] = 0; // terminate string
+
+    if (lineTooLong || inputBufferIndex > 0) {
+        fOK = lineTooLong ? fasitoError(E_LINE_TOO_LONG) : handleCommand();
+        if (!fOK) {
+            Serial.print("ERROR ");
+            Serial.println(inputBuffer); // inputBuffer contains the error message
+        } else {
+            Serial.println("OK");
         }
+    }
 
-        if (c == '\r') {
-            digitalWrite(LED, HIGH);
+    *inputBuffer = 0;
+    inputBufferIndex = 0;
+    lineTooLong = false;
+    Serial.endResponse();
+
+    if (currentCommand) {
+        recordCommand(currentCommand - commands, micros() - start, fOK);
+        checkStack(currentCommand - commands);
+    }
 
-            inputBuffer[inputBufferIndex] = 0; // terminate string
+    digitalWrite(LED, LOW);
+    clockIdle();
+}
 
-            if (inputBufferIndex > 0) {
-                if (!handleCommand()) {
-                    Serial.print("ERROR ");
-                    Serial.println(inputBuffer); // inputBuffer contains the error message
-                } else {
-                    Serial.println("OK");
-                }
-            }
+/* a host that opens the port again starts a new session in hex */
+static void checkLineState()
+{
+    static uint8_t dtr;
 
-            *inputBuffer = 0;
-            inputBufferIndex = 0;
-            Serial.flush();
-            digitalWrite(LED, LOW);
+    if (Serial.dtr() != dtr) {
+        dtr = Serial.dtr();
+        encoding = ENC_HEX;
+    }
+}
+
+void loop()
+{
+    int c;
+
+    checkLineState();
+
+    if (!serialEcho) {
+        // the USB interrupt assembles the lines, only wake up for whole commands
+        int len = Serial.readLine(inputBuffer, INPUT_BUFFER_SIZE);
+
+        /* one slice of background work, then look for a command again */
+        if (len < 0 && len != USB_SERIAL_LINE_TOO_LONG) {
+            if (!runTasks())
+                WFI;
+            return;
+        }
 
+        lineTooLong = len == USB_SERIAL_LINE_TOO_LONG;
+        inputBufferIndex = lineTooLong ? 0 : len;
+        processLine();
+        return;
+    }
+
+    if (Serial.available() > 0) {
+        c = Serial.read();
+
+        if (c == '\r') {
+            Serial.println();
+            processLine();
             return;
         }
 
-        if (inputBufferIndex >= (INPUT_BUFFER_SIZE - 1))
+        char echo[2] = { 0, 0 };
+        echo[0] = c;
+        Serial.print(echo);
+
+        if (inputBufferIndex >= (INPUT_BUFFER_SIZE - 1)) {
+            lineTooLong = true;
             inputBufferIndex = 0;
+        }
 
         inputBuffer[inputBufferIndex++] = c;
-    } else {
+    } else if (!runTasks()) {
         WFI;
     }
 }
@@ -149,9 +232,14 @@ bool handleCommand()
     if (c == NULL || !c->handler)
         return fasitoError(E_COMMAND_NOT_FOUND);
 
+    currentCommand = c;
+
     if (c->requireLogin && !loggedIn)
         return fasitoError(E_NOT_LOGGED_IN);
 
+    if (c->boost)
+        clockBoost();
+
     const char **tokens = tokenise(&inputBuffer[c->len], &nTokens);
     return c->handler(tokens, nTokens);
 }
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * memstats.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Arduino.h"
+#include "fasito.h"
+#include "utils.h"
+#include "commands.h"
+#include "cmdstats.h"
+#include "memstats.h"
+#ifndef FASITO_EMU
+#include <malloc.h>
+#include "usb_dev.h"
+
+#define RAM_SIZE                0x10000
+#define STACK_PAINT             0xC5C5C5C5
+/* words below the stack pointer left alone by paintStack() */
+#define STACK_PAINT_MARGIN      16
+
+extern "C" char *__brkval;
+extern "C" unsigned long _sram, _sdata, _edata, _sbss, _ebss, _estack;
+
+/* lowest stack word found overwritten and the command that got there */
+static uint32_t *stackLow = NULL;
+static uint8_t stackLowCommand = MEM_BOOT;
+/* where checkStackSlice() continues, NULL: at the end of the heap */
+static uint32_t *stackScan = NULL;
+
+static inline uint32_t *stackPointer()
+{
+    uint32_t *sp;
+
+    asm volatile ("mov %0, sp" : "=r" (sp));
+    return sp;
+}
+
+/* first word above the heap, the stack can grow down to it */
+static inline uint32_t *heapEnd()
+{
+    return (uint32_t *)(((uintptr_t)__brkval + 3) & ~(uintptr_t)3);
+}
+
+void paintStack()
+{
+    /* an interrupt would push its frame into the area being painted */
+    __disable_irq();
+    uint32_t *p = heapEnd();
+    uint32_t *end = stackPointer() - STACK_PAINT_MARGIN;
+
+    while (p < end)
+        *p++ = STACK_PAINT;
+
+    stackLow = end;
+    stackLowCommand = MEM_BOOT;
+    stackScan = NULL;
+    __enable_irq();
+}
+
+void checkStack(uint8_t command)
+{
+    uint32_t *p = heapEnd();
+
+    /* everything below stackLow was untouched at the last check */
+    while (p < stackLow && *p == STACK_PAINT)
+        p++;
+
+    if (p < stackLow) {
+        stackLow = p;
+        stackLowCommand = command;
+    }
+}
+
+bool checkStackSlice(uint8_t command, uint32_t maxWords)
+{
+    uint32_t *p = stackScan;
+
+    /* the heap may have grown over the words scanned so far */
+    if (!p || p < heapEnd())
+        p = heapEnd();
+
+    while (maxWords-- > 0 && p < stackLow && *p == STACK_PAINT)
+        p++;
+
+    if (p < stackLow && *p == STACK_PAINT) {
+        stackScan = p;
+        return true;
+    }
+
+    if (p < stackLow) {
+        stackLow = p;
+        stackLowCommand = command;
+    }
+
+    stackScan = NULL;
+    return false;
+}
+
+uint32_t heapInUse()
+{
+    return mallinfo().uordblks;
+}
+#endif
+
+static void printBufferLine(const char *name, const uint32_t bytes)
+{
+    char line[80];
+
+    sprintf(line, "%s: %lu bytes", name, (unsigned long)bytes);
+    Serial.println(line);
+}
+
+void printMemStats()
+{
+#ifndef FASITO_EMU
+    char line[160];
+    const uint32_t ramStart = (uint32_t)&_sram;
+    const uint32_t heapStart = (uint32_t)&_ebss;
+    const uint32_t heapTop = (uint32_t)heapEnd();
+    const uint32_t sp = (uint32_t)stackPointer();
+    const struct mallinfo mi = mallinfo();
+
+    sprintf(line, "RAM              : %lu bytes, static %lu (data %lu, bss %lu, USB/DMA %lu)", (unsigned long)RAM_SIZE,
+            (unsigned long)(heapStart - ramStart), (unsigned long)((uint32_t)&_edata - (uint32_t)&_sdata),
+            (unsigned long)((uint32_t)&_ebss - (uint32_t)&_sbss), (unsigned long)((uint32_t)&_sdata - ramStart));
+    Serial.println(line);
+    sprintf(line, "Heap             : %lu bytes, in use %lu, free %lu", (unsigned long)(heapTop - heapStart),
+            (unsigned long)mi.uordblks, (unsigned long)mi.fordblks);
+    Serial.println(line);
+    sprintf(line, "Stack            : %lu bytes, max %lu bytes (%s)", (unsigned long)((uint32_t)&_estack - sp),
+            (unsigned long)((uint32_t)&_estack - (uint32_t)stackLow),
+            stackLowCommand < numCommands ? commands[stackLowCommand].command : stackLowCommand == MEM_IDLE ? "idle" : "boot");
+    Serial.println(line);
+    sprintf(line, "Free RAM         : %lu bytes, min %lu bytes", (unsigned long)(sp - heapTop),
+            (unsigned long)((uint32_t)stackLow > heapTop ? (uint32_t)stackLow - heapTop : 0));
+    Serial.println(line);
+    printBufferLine("secp256k1 context", contextBytes);
+#endif
+
+    printBufferLine("Input buffer     ", INPUT_BUFFER_SIZE);
+    printBufferLine("NVRam copy       ", sizeof(FasitoNVRam));
+    printBufferLine("Nonce pool       ", NUM_NONCE_POOL * 32);
+    printBufferLine("Command stats    ", MAX_COMMANDS * sizeof(CommandStats));
+#ifndef FASITO_EMU
+    printBufferLine("USB buffers      ", NUM_USB_BUFFERS * sizeof(usb_packet_t));
+    printBufferLine("USB line buffer  ", USB_SERIAL_LINE_BUFFER);
+#endif
+}
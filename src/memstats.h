@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * memstats.h is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_MEMSTATS_H_
+#define SRC_MEMSTATS_H_
+
+#include <stdint.h>
+
+/* checkStack() after setup() or from the idle loop rather than a command */
+#define MEM_BOOT                0xFF
+#define MEM_IDLE                0xFE
+
+/*
+ * The free RAM between the heap and the stack is painted at boot, the lowest
+ * overwritten word gives the stack high-water mark (interrupts included).
+ */
+#ifndef FASITO_EMU
+extern void paintStack();
+extern void checkStack(uint8_t command);
+/* checkStack() in steps of at most maxWords, returns true until the scan is complete */
+extern bool checkStackSlice(uint8_t command, uint32_t maxWords);
+extern uint32_t heapInUse();
+#else
+static inline void paintStack() {}
+static inline void checkStack(uint8_t command) { (void)command; }
+static inline bool checkStackSlice(uint8_t command, uint32_t maxWords) { (void)command; (void)maxWords; return false; }
+static inline uint32_t heapInUse() { return 0; }
+#endif
+extern void printMemStats();
+
+#endif /* SRC_MEMSTATS_H_ */
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * nvram.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* This file must not depend on the Arduino core, so the migration
+ * steps can be compiled and exercised on a Linux host as well.
+ */
+
+#include <string.h>
+#include "nvram.h"
+
+static bool upgradeV1(uint8_t *image);
+
+/* all known layouts, oldest first. The entry for CONFIG_VERSION has no upgrade function. */
+static const NVRamLayout layouts[] = {
+        { 1, sizeof(FasitoNVRamV1), 0,                upgradeV1 },
+        { 2, sizeof(FasitoNVRam),   NVRAM_HOT_OFFSET, NULL      },
+};
+
+#define NUM_LAYOUTS (sizeof(layouts) / sizeof(NVRamLayout))
+
+static_assert(sizeof(FasitoNVRam) <= NVRAM_MAX_IMAGE_SIZE, "NVRAM_MAX_IMAGE_SIZE too small");
+static_assert(NVRAM_HOT_OFFSET % 4 == 0 && NVRAM_HOT_SIZE % 4 == 0, "NVRam regions must be 32-bit aligned");
+static_assert(offsetof(FasitoNVRam, privateKey) % 4 == 0 && sizeof(PrivateKey) % 4 == 0, "private keys must be 32-bit aligned");
+
+static void crc16_update(uint16_t &crc, uint8_t data)
+{
+    unsigned int i;
+
+    crc ^= data;
+    for (i = 0; i < 8; ++i) {
+        if (crc & 1)
+            crc = (crc >> 1) ^ 0xA001;
+        else
+            crc = crc >> 1;
+    }
+}
+
+uint16_t nvramChecksum(const uint8_t *data, uint16_t len)
+{
+    uint16_t i, crc = 0;
+    for (i = 0 ; i < len ; i++)
+        crc16_update(crc, data[i]);
+
+    return crc;
+}
+
+static const NVRamLayout *findLayout(uint8_t version)
+{
+    size_t i;
+
+    for (i = 0 ; i < NUM_LAYOUTS ; i++) {
+        if (layouts[i].version == version)
+            return &layouts[i];
+    }
+
+    return NULL;
+}
+
+uint16_t nvramImageSize(const uint8_t *image)
+{
+    const NVRamLayout *layout = findLayout(*image);
+
+    return layout ? layout->size : 0;
+}
+
+static bool checkRegion(const uint8_t *region, uint16_t size)
+{
+    uint16_t checksum;
+
+    memcpy(&checksum, &region[size - 2], 2);
+    return checksum == nvramChecksum(region, size - 2);
+}
+
+static void updateRegion(uint8_t *region, uint16_t size)
+{
+    uint16_t checksum = nvramChecksum(region, size - 2);
+    memcpy(&region[size - 2], &checksum, 2);
+}
+
+bool nvramImageValid(const uint8_t *image)
+{
+    const NVRamLayout *layout = findLayout(*image);
+
+    if (!layout)
+        return false;
+
+    if (!layout->hotOffset)
+        return checkRegion(image, layout->size);
+
+    return checkRegion(image, layout->hotOffset) &&
+           checkRegion(&image[layout->hotOffset], layout->size - layout->hotOffset);
+}
+
+void nvramUpdateChecksum(uint8_t *image)
+{
+    const NVRamLayout *layout = findLayout(*image);
+
+    if (!layout)
+        return;
+
+    if (!layout->hotOffset) {
+        updateRegion(image, layout->size);
+        return;
+    }
+
+    updateRegion(image, layout->hotOffset);
+    updateRegion(&image[layout->hotOffset], layout->size - layout->hotOffset);
+}
+
+/* the following two only apply to the current layout */
+void nvramUpdateColdChecksum(uint8_t *image)
+{
+    updateRegion(image, NVRAM_HOT_OFFSET);
+}
+
+void nvramUpdateHotChecksum(uint8_t *image)
+{
+    updateRegion(&image[NVRAM_HOT_OFFSET], NVRAM_HOT_SIZE);
+}
+
+/* v1 -> v2: 32-bit aligned private keys, PIN state and counters moved into the hot region */
+static bool upgradeV1(uint8_t *image)
+{
+    FasitoNVRamV1 v1;
+    FasitoNVRam *v2 = (FasitoNVRam *)image;
+    int i;
+
+    memcpy(&v1, image, sizeof(FasitoNVRamV1));
+    memset(image, 0, sizeof(FasitoNVRam));
+
+    v2->fasitoStatus = v1.fasitoStatus;
+    for (i = 0 ; i < NUM_PRIVATE_KEYS ; i++) {
+        v2->privateKey[i].nodeId = v1.privateKey[i].nodeId;
+        v2->privateKey[i].status = v1.privateKey[i].status;
+        memcpy(v2->privateKey[i].key, v1.privateKey[i].key, 32);
+    }
+    memcpy(v2->adminPublicKey, v1.adminPublicKey, sizeof(v2->adminPublicKey));
+
+    v2->userPin    = v1.userPin;
+    v2->resetCount = v1.resetCount;
+
+    memset(&v1, 0, sizeof(FasitoNVRamV1));
+    return true;
+}
+
+/* image must be 32-bit aligned and at least NVRAM_MAX_IMAGE_SIZE bytes long */
+int migrateNVRam(uint8_t *image)
+{
+    if (!nvramImageValid(image))
+        return NVRAM_INVALID;
+
+    const uint8_t fromVersion = *image;
+
+    while (*image != CONFIG_VERSION) {
+        const NVRamLayout *layout = findLayout(*image);
+
+        if (!layout || !layout->upgrade || !layout->upgrade(image))
+            return NVRAM_INVALID;
+
+        *image = layout->version + 1;
+        nvramUpdateChecksum(image);
+
+        if (!nvramImageValid(image))
+            return NVRAM_INVALID;
+    }
+
+    return *image == fromVersion ? NVRAM_CURRENT : NVRAM_MIGRATED;
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * nvram.h is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_NVRAM_H_
+#define SRC_NVRAM_H_
+
+#include <stdint.h>
+#include "fasito.h"
+
+/* Every NVRam layout starts with the version byte and ends with
+ * the CRC16 checksum over all preceding bytes. Layouts with a hot
+ * region (hotOffset != 0) end the cold region with a checksum of
+ * its own and the final checksum only covers the hot region.
+ * Anything in between may change from one CONFIG_VERSION to the next.
+ */
+
+/* layout of CONFIG_VERSION 1 */
+typedef struct PrivateKeyV1 {
+    uint32_t nodeId;
+    uint8_t  key[32];
+    uint8_t  status;
+} PrivateKeyV1;
+
+typedef struct FasitoNVRamV1 {
+    uint8_t    version;
+    uint8_t    fasitoStatus;
+
+    UserPIN    userPin;
+    PrivateKeyV1 privateKey[NUM_PRIVATE_KEYS];
+    secp256k1_pubkey adminPublicKey[NUM_ADMIN_KEYS];
+
+    uint16_t   resetCount;
+    uint16_t   checksum;
+} FasitoNVRamV1;
+
+#define NVRAM_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+/* large enough to hold every layout listed in nvram.cpp */
+#define NVRAM_MAX_IMAGE_SIZE NVRAM_MAX(sizeof(FasitoNVRamV1), sizeof(FasitoNVRam))
+
+enum {
+    NVRAM_INVALID,
+    NVRAM_CURRENT,
+    NVRAM_MIGRATED
+};
+
+typedef struct NVRamLayout {
+    uint8_t  version;
+    uint16_t size;
+    uint16_t hotOffset;
+    /* transforms an image of this version into the next version in place */
+    bool (*upgrade)(uint8_t *image);
+} NVRamLayout;
+
+extern uint16_t nvramChecksum(const uint8_t *data, uint16_t len);
+extern uint16_t nvramImageSize(const uint8_t *image);
+extern bool nvramImageValid(const uint8_t *image);
+extern void nvramUpdateChecksum(uint8_t *image);
+extern void nvramUpdateColdChecksum(uint8_t *image);
+extern void nvramUpdateHotChecksum(uint8_t *image);
+extern int migrateNVRam(uint8_t *image);
+
+#endif /* SRC_NVRAM_H_ */
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * opstats.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Arduino.h"
+#include "opstats.h"
+#ifndef FASITO_EMU
+#include "usb_dev.h"
+#endif
+
+static OpStats opStats[NUM_OPS];
+
+static const char *opNames[NUM_OPS] = {
+        "NVRam read       ",
+        "NVRam write      ",
+        "NVRam hot write  ",
+        "Flash erase      ",
+        "Flash program    ",
+        "IRQs disabled    ",
+};
+
+void enableCycleCounter()
+{
+    ARM_DEMCR |= ARM_DEMCR_TRCENA;
+    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+}
+
+void recordOp(uint8_t op, uint32_t cycles, uint32_t bytes)
+{
+    OpStats *s = &opStats[op];
+
+    /* ops run at idle and at boost clock, keep them comparable */
+    cycles *= F_CPU / F_CPU_ACTUAL;
+
+    if (!s->count || cycles < s->min)
+        s->min = cycles;
+    if (cycles > s->max)
+        s->max = cycles;
+
+    s->last = cycles;
+    s->count++;
+    s->bytes += bytes;
+}
+
+void resetOpStats()
+{
+    memset(opStats, 0, sizeof(opStats));
+    memset(&eeprom_stats, 0, sizeof(eeprom_stats));
+#ifndef FASITO_EMU
+    __disable_irq();
+    memset((void *)&usb_stats, 0, sizeof(usb_stats));
+    __enable_irq();
+#endif
+}
+
+static void printOpLine(const char *name, const uint32_t count, const uint32_t last, const uint32_t min, const uint32_t max, const uint32_t bytes)
+{
+    char line[160];
+
+    sprintf(line, "%s: count %lu, last %lu us, min %lu us, max %lu us, changed %lu bytes", name, (unsigned long)count,
+            (unsigned long)OP_CYCLES_TO_US(last), (unsigned long)OP_CYCLES_TO_US(min), (unsigned long)OP_CYCLES_TO_US(max), (unsigned long)bytes);
+    Serial.println(line);
+}
+
+void printOpStats()
+{
+    uint8_t i;
+
+    for (i = 0 ; i < NUM_OPS ; i++) {
+        const OpStats *s = &opStats[i];
+        printOpLine(opNames[i], s->count, s->last, s->min, s->max, s->bytes);
+    }
+
+    printOpLine("FlexRAM wait     ", eeprom_stats.count, eeprom_stats.last, eeprom_stats.min, eeprom_stats.max, eeprom_stats.bytes);
+
+#ifndef FASITO_EMU
+    char line[160];
+    struct usb_stats u;
+
+    __disable_irq();
+    memcpy(&u, (const void *)&usb_stats, sizeof(u));
+    __enable_irq();
+
+    sprintf(line, "USB buffers      : %d of %d bytes, tx limit %d, rx/tx packet size %d/%d bytes",
+            NUM_USB_BUFFERS, (int)sizeof(usb_packet_t), TX_PACKET_LIMIT, CDC_RX_SIZE, CDC_TX_SIZE);
+    Serial.println(line);
+    sprintf(line, "USB receive      : %lu packets, starved %lu times", (unsigned long)u.rx_packets, (unsigned long)u.rx_starved);
+    Serial.println(line);
+    sprintf(line, "USB transmit     : %lu packets, queued %lu, zero length %lu, wait loops %lu, timeouts %lu, no buffer %lu times",
+            (unsigned long)u.tx_packets, (unsigned long)u.tx_queued, (unsigned long)u.tx_zlps, (unsigned long)u.tx_waits,
+            (unsigned long)u.tx_timeouts, (unsigned long)u.malloc_failed);
+    Serial.println(line);
+#endif
+}
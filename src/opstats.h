@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * opstats.h is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_OPSTATS_H_
+#define SRC_OPSTATS_H_
+
+#include <stdint.h>
+#include <avr/eeprom.h>
+
+/* timing of persistent storage and flash operations */
+enum {
+    OP_NVRAM_READ,
+    OP_NVRAM_WRITE,
+    OP_NVRAM_HOT_WRITE,
+    OP_FLASH_ERASE,
+    OP_FLASH_PROGRAM,
+    OP_IRQ_OFF,
+    NUM_OPS
+};
+
+/* times are in CPU cycles at F_CPU */
+typedef struct OpStats {
+    uint32_t count;
+    uint32_t last;
+    uint32_t min;
+    uint32_t max;
+    uint32_t bytes;
+} OpStats;
+
+/* cycles at the current core clock, see clock.h */
+#define CYCLES_TO_US(c) ((c) / (F_CPU_ACTUAL / 1000000))
+/* cycles as stored in OpStats */
+#define OP_CYCLES_TO_US(c) ((c) / (F_CPU / 1000000))
+
+static inline __attribute__((always_inline)) uint32_t cycleCount()
+{
+    return ARM_DWT_CYCCNT;
+}
+
+extern void enableCycleCounter();
+extern void recordOp(uint8_t op, uint32_t cycles, uint32_t bytes);
+extern void resetOpStats();
+extern void printOpStats();
+
+#endif /* SRC_OPSTATS_H_ */
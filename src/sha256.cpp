@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * sha256.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "sha256.h"
+
+static const uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void transform(uint32_t *s, const uint8_t *chunk)
+{
+    uint32_t w[64], a, b, c, d, e, f, g, h;
+    int i;
+
+    for (i = 0 ; i < 16 ; i++)
+        w[i] = (uint32_t)chunk[i * 4] << 24 | (uint32_t)chunk[i * 4 + 1] << 16 | (uint32_t)chunk[i * 4 + 2] << 8 | chunk[i * 4 + 3];
+
+    for (i = 16 ; i < 64 ; i++) {
+        const uint32_t s0 = ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const uint32_t s1 = ROR(w[i - 2], 17) ^ ROR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    a = s[0]; b = s[1]; c = s[2]; d = s[3];
+    e = s[4]; f = s[5]; g = s[6]; h = s[7];
+
+    for (i = 0 ; i < 64 ; i++) {
+        const uint32_t t1 = h + (ROR(e, 6) ^ ROR(e, 11) ^ ROR(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        const uint32_t t2 = (ROR(a, 2) ^ ROR(a, 13) ^ ROR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+
+    s[0] += a; s[1] += b; s[2] += c; s[3] += d;
+    s[4] += e; s[5] += f; s[6] += g; s[7] += h;
+}
+
+void sha256Init(Sha256 *hash)
+{
+    hash->state[0] = 0x6a09e667;
+    hash->state[1] = 0xbb67ae85;
+    hash->state[2] = 0x3c6ef372;
+    hash->state[3] = 0xa54ff53a;
+    hash->state[4] = 0x510e527f;
+    hash->state[5] = 0x9b05688c;
+    hash->state[6] = 0x1f83d9ab;
+    hash->state[7] = 0x5be0cd19;
+    hash->bytes = 0;
+}
+
+void sha256Update(Sha256 *hash, const uint8_t *data, size_t len)
+{
+    size_t fill = hash->bytes % 64;
+
+    hash->bytes += len;
+
+    if (fill) {
+        size_t n = 64 - fill;
+        if (n > len)
+            n = len;
+
+        memcpy(&hash->buf[fill], data, n);
+        data += n;
+        len -= n;
+
+        if (fill + n < 64)
+            return;
+
+        transform(hash->state, hash->buf);
+    }
+
+    while (len >= 64) {
+        transform(hash->state, data);
+        data += 64;
+        len -= 64;
+    }
+
+    memcpy(hash->buf, data, len);
+}
+
+void sha256Final(Sha256 *hash, uint8_t *out)
+{
+    static const uint8_t pad[64] = { 0x80 };
+    const uint64_t bits = hash->bytes << 3;
+    uint8_t length[8];
+    int i;
+
+    for (i = 0 ; i < 8 ; i++)
+        length[i] = bits >> (56 - i * 8);
+
+    sha256Update(hash, pad, 1 + ((119 - (hash->bytes % 64)) % 64));
+    sha256Update(hash, length, 8);
+
+    for (i = 0 ; i < 8 ; i++) {
+        out[i * 4]     = hash->state[i] >> 24;
+        out[i * 4 + 1] = hash->state[i] >> 16;
+        out[i * 4 + 2] = hash->state[i] >> 8;
+        out[i * 4 + 3] = hash->state[i];
+    }
+}
@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * sha256.h is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_SHA256_H_
+#define SRC_SHA256_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* incremental SHA-256, libsecp256k1 only exports one-shot hashing */
+typedef struct Sha256 {
+    uint32_t state[8];
+    uint8_t  buf[64];
+    uint64_t bytes;
+} Sha256;
+
+extern void sha256Init(Sha256 *hash);
+extern void sha256Update(Sha256 *hash, const uint8_t *data, size_t len);
+extern void sha256Final(Sha256 *hash, uint8_t *out);
+
+#endif /* SRC_SHA256_H_ */
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * tasks.cpp is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Arduino.h"
+#include "opstats.h"
+#include "memstats.h"
+#include "tasks.h"
+#ifndef FASITO_EMU
+#include <IntervalTimer.h>
+#endif
+
+/* words of free RAM compared per slice, about 5 cycles each at the idle clock */
+#define STACK_CHECK_WORDS       1024
+
+/* catches stack peaks of the interrupts that no command check sees, the free
+ * RAM is scanned in slices of STACK_CHECK_WORDS */
+static bool taskStackCheck()
+{
+    return checkStackSlice(MEM_IDLE, STACK_CHECK_WORDS);
+}
+
+static const Task tasks[NUM_TASKS] = {
+        {"Stack check      ", taskStackCheck, 1000},
+};
+
+static TaskStats taskStats[NUM_TASKS];
+static uint32_t lastRun[NUM_TASKS];
+static bool pending[NUM_TASKS];
+static volatile uint32_t taskTicks = 0;
+
+#ifndef FASITO_EMU
+static IntervalTimer taskTimer;
+
+/* only wakes the WFI in loop(), runTasks() decides what is due */
+static void taskTick()
+{
+    taskTicks++;
+}
+#endif
+
+void startTasks()
+{
+    const uint32_t now = millis();
+    uint8_t i;
+
+    for (i = 0 ; i < NUM_TASKS ; i++)
+        lastRun[i] = now;
+
+#ifndef FASITO_EMU
+    taskTimer.begin(taskTick, TASK_TICK_US);
+#endif
+}
+
+/* runs the task at its next slice, from the main program only */
+void scheduleTask(uint8_t task)
+{
+    pending[task] = true;
+}
+
+bool runTasks()
+{
+    const uint32_t now = millis();
+    uint8_t i;
+
+    for (i = 0 ; i < NUM_TASKS ; i++) {
+        const Task *t = &tasks[i];
+
+        if (!pending[i] && !(t->periodMs && now - lastRun[i] >= t->periodMs))
+            continue;
+
+        const uint32_t start = cycleCount();
+        pending[i] = t->run();
+        /* tasks run at the idle clock, keep them comparable with ops */
+        const uint32_t cycles = (cycleCount() - start) * (F_CPU / F_CPU_ACTUAL);
+
+        TaskStats *s = &taskStats[i];
+        s->runs++;
+        s->total += cycles;
+        if (cycles > s->max)
+            s->max = cycles;
+        if (OP_CYCLES_TO_US(cycles) > TASK_SLICE_US)
+            s->overruns++;
+
+        lastRun[i] = now;
+        return true;
+    }
+
+    return false;
+}
+
+void resetTaskStats()
+{
+    memset(taskStats, 0, sizeof(taskStats));
+    taskTicks = 0;
+}
+
+void printTaskStats()
+{
+    char line[160];
+    uint8_t i;
+
+    for (i = 0 ; i < NUM_TASKS ; i++) {
+        const TaskStats *s = &taskStats[i];
+
+        sprintf(line, "%s: runs %lu, avg %lu us, max %lu us, overruns %lu%s", tasks[i].name, (unsigned long)s->runs,
+                (unsigned long)(s->runs ? OP_CYCLES_TO_US(s->total / s->runs) : 0), (unsigned long)OP_CYCLES_TO_US(s->max),
+                (unsigned long)s->overruns, pending[i] ? ", pending" : "");
+        Serial.println(line);
+    }
+
+#ifndef FASITO_EMU
+    sprintf(line, "Timer ticks      : %lu (every %u us), slice budget %u us", (unsigned long)taskTicks, TASK_TICK_US, TASK_SLICE_US);
+    Serial.println(line);
+#endif
+}
@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2017-2022 by Thomas König <tom@faircoin.world>
+ *
+ * tasks.h is part of Fasito, the FairCoin signature token.
+ *
+ * Fasito is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Fasito is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Fasito, see file COPYING.
+ * If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SRC_TASKS_H_
+#define SRC_TASKS_H_
+
+#include <stdint.h>
+
+/*
+ * Cooperative background tasks: loop() runs one slice of the most urgent
+ * task whenever no complete command is waiting, so a command waits at most
+ * for the slice that is running. Tasks are listed by priority in tasks[].
+ */
+
+/* IntervalTimer period waking the idle loop for periodic tasks */
+#define TASK_TICK_US            10000
+/* a slice should return within this time, longer ones count as overruns */
+#define TASK_SLICE_US           500
+
+enum {
+    TASK_STACK_CHECK,
+    NUM_TASKS
+};
+
+typedef struct Task {
+    const char *name;
+    bool (*run)();          /* one bounded slice, returns true while work is left */
+    uint32_t periodMs;      /* 0: only after scheduleTask() */
+} Task;
+
+/* times are in CPU cycles at F_CPU */
+typedef struct TaskStats {
+    uint32_t runs;
+    uint32_t overruns;
+    uint32_t max;
+    uint64_t total;
+} TaskStats;
+
+extern void startTasks();
+extern void scheduleTask(uint8_t task);
+extern bool runTasks();
+extern void resetTaskStats();
+extern void printTaskStats();
+
+#endif /* SRC_TASKS_H_ */
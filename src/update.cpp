@@ -22,19 +22,52 @@
 #include "fasito.h"
 #include "utils.h"
 #include "fasito_error.h"
+#include "opstats.h"
+#include "sha256.h"
 
 #define WAIT_FOR_COMMAND_COMPLETION(a) while (!(FTFL_FSTAT & FTFL_FSTAT_CCIF)) ;
 
 #define SECTOR_SIZE  0x0800
 
+/* new firmware images are received into the upper half of the flash */
+#define STAGING_ADDR 0x00020000
+#define STAGING_SIZE 0x00020000
+
+/* flash configuration field, holds the protection bits */
+#define FCF_ADDR     0x0400
+#define FCF_SIZE     0x0010
+
+/* an image starts with the vector table: initial stack pointer, reset handler
+ * and the other core exceptions, the FCF follows at 0x400 */
+#define CORE_VECTORS_SIZE 0x0040
+#define RAM_START    0x1FFF8000
+#define RAM_END      0x20008000
+
+#define RECEIVE_TIMEOUT 5000
+
+static_assert(INPUT_BUFFER_SIZE >= SECTOR_SIZE, "inputBuffer is used as sector buffer");
+
 #define CMD_PGM4     0x06
 #define CMD_ERSSCR   0x09
+#define CMD_PGMSEC   0x0B
+#define CMD_SETRAM   0x81
+
+#define SETRAM_RAM   0xFF
+#define SETRAM_EEE   0x00
+
+#if defined(__MK20DX128__) || defined(__MK20DX256__)
+/* the FTFL of these parts has 2 KB of FlexRAM, which can hold a whole
+ * sector as section program buffer */
+#define HAS_PROGRAM_SECTION
+#define FLEXRAM      ((volatile uint32_t *)0x14000000)
+#endif
 
 #define SEAL_BITS    0b01100100
 #define UNSEAL_BITS  0b11011110
 
 #define B(b) ((b) & 0xff)
 
+#ifndef FASITO_EMU
 /* Execute the flash command */
 FASTRUN static void executeCMD(volatile uint8_t *pFstat)
 {
@@ -42,7 +75,7 @@ FASTRUN static void executeCMD(volatile uint8_t *pFstat)
     while (!(*pFstat & FTFL_FSTAT_CCIF)) ; // wait for the command to complete
 }
 
-FASTRUN static bool eraseSector0()
+FASTRUN static bool eraseSector(const uint32_t address)
 {
     // make sure no other operation is taking place
     WAIT_FOR_COMMAND_COMPLETION();
@@ -53,9 +86,10 @@ FASTRUN static bool eraseSector0()
     // command: erase flash sector
     FTFL_FCCOB0 = CMD_ERSSCR;
 
-    FTFL_FCCOB1 = 0;
-    FTFL_FCCOB2 = 0;
-    FTFL_FCCOB3 = 0;
+    // 24bit address of the sector
+    FTFL_FCCOB1 = B(address >> 16);
+    FTFL_FCCOB2 = B(address >> 8);
+    FTFL_FCCOB3 = B(address);
 
     executeCMD(&FTFL_FSTAT);
 
@@ -93,230 +127,466 @@ FASTRUN static bool programLongword(const uint32_t address, const uint32_t value
     return !(FTFL_FSTAT & (FTFL_FSTAT_ACCERR | FTFL_FSTAT_FPVIOL | FTFL_FSTAT_MGSTAT0));
 }
 
-FASTRUN static bool programFSEC(const uint8_t state)
+#ifdef HAS_PROGRAM_SECTION
+/* switches the FlexRAM between EEPROM and section program buffer */
+FASTRUN static bool setFlexRam(const uint8_t function)
 {
-    uint8_t sector[SECTOR_SIZE];
-    const uint8_t *pFlash = 0x00;
+    const uint8_t ready = function == SETRAM_RAM ? FTFL_FCNFG_RAMRDY : FTFL_FCNFG_EEERDY;
+    uint32_t count = 0;
 
-    __disable_irq();
+    // make sure no other operation is taking place
+    WAIT_FOR_COMMAND_COMPLETION();
 
-    for (int i = 0 ; i < SECTOR_SIZE ; i++) {
-        sector[i] = pFlash[i];
-    }
+    // clear previous error flags
+    FTFL_FSTAT = FTFL_FSTAT_ACCERR | FTFL_FSTAT_FPVIOL;
 
-    sector[0x040c] = state;
+    // command: set FlexRAM function
+    FTFL_FCCOB0 = CMD_SETRAM;
+    FTFL_FCCOB1 = function;
 
-    if (!eraseSector0()) {
-        __enable_irq();
+    executeCMD(&FTFL_FSTAT);
+
+    WAIT_FOR_COMMAND_COMPLETION();
+
+    if (FTFL_FSTAT & (FTFL_FSTAT_ACCERR | FTFL_FSTAT_FPVIOL))
         return false;
+
+    while (!(FTFL_FCNFG & ready)) {
+        if (++count > 200000)
+            return false;
     }
 
-    const uint32_t *sectorB64 = (uint32_t *) sector;
-    bool fOK = true;
+    return true;
+}
+
+/* programs nLongwords from the FlexRAM to address in a single command */
+FASTRUN static bool programSection(const uint32_t address, const uint16_t nLongwords)
+{
+    // make sure no other operation is taking place
+    WAIT_FOR_COMMAND_COMPLETION();
+
+    // clear previous error flags
+    FTFL_FSTAT = FTFL_FSTAT_ACCERR | FTFL_FSTAT_FPVIOL;
+
+    // command: program section
+    FTFL_FCCOB0 = CMD_PGMSEC;
+
+    // 24bit address to program
+    FTFL_FCCOB1 = B(address >> 16);
+    FTFL_FCCOB2 = B(address >> 8);
+    FTFL_FCCOB3 = B(address);
+
+    // number of long words to program
+    FTFL_FCCOB4 = B(nLongwords >> 8);
+    FTFL_FCCOB5 = B(nLongwords);
+
+    executeCMD(&FTFL_FSTAT);
+
+    WAIT_FOR_COMMAND_COMPLETION();
+
+    return !(FTFL_FSTAT & (FTFL_FSTAT_ACCERR | FTFL_FSTAT_FPVIOL | FTFL_FSTAT_MGSTAT0));
+}
+#endif
+
+/* programs the data longword by longword, skipping erased values */
+FASTRUN static bool programLongwords(const uint32_t address, const volatile uint32_t *data)
+{
     for (int i = 0 ; i < SECTOR_SIZE / 4; i++) {
-        if (!programLongword(i * 4, sectorB64[i])) {
-            fOK = false;
+        const uint32_t value = data[i];
+
+        /* erased flash reads 0xffffffff already */
+        if (value != 0xffffffff && !programLongword(address + i * 4, value))
+            return false;
+    }
+
+    return true;
+}
+
+/* erases a sector and programs it from data, which must not lie in the same sector */
+FASTRUN static bool writeSector(const uint32_t address, const uint32_t *data)
+{
+    return eraseSector(address) && programLongwords(address, data);
+}
+
+/* Rewrites sector 0 with the new protection state. Where the part has a
+ * section program buffer, the sector is copied straight into the FlexRAM and
+ * programmed with a single command, otherwise inputBuffer serves as copy.
+ * Returns the number of cycles spent with interrupts disabled in irqOffCycles,
+ * failures are reported with fasitoErrorStr().
+ */
+FASTRUN static bool programFSEC(const uint8_t state, uint32_t *irqOffCycles)
+{
+    const uint32_t *pFlash = 0x00;
+    volatile uint32_t *sector = (uint32_t *)inputBuffer;
+    uint32_t start, erased, programmed;
+    bool fOK = false, section = false, eeeOK = true;
+
+    __disable_irq();
+    const uint32_t irqOff = cycleCount();
+
+#ifdef HAS_PROGRAM_SECTION
+    section = setFlexRam(SETRAM_RAM);
+    if (section)
+        sector = FLEXRAM;
+#endif
+
+    for (int i = 0 ; i < SECTOR_SIZE / 4 ; i++) {
+        sector[i] = pFlash[i];
+    }
+
+    ((volatile uint8_t *)sector)[0x040c] = state;
+
+    start = cycleCount();
+
+    if (eraseSector(0)) {
+        erased = cycleCount();
+
+        bool blank = true;
+
+#ifdef HAS_PROGRAM_SECTION
+        if (section) {
+            fOK = programSection(0, SECTOR_SIZE / 4);
+            /* PGMSEC may have stopped partway, programmed longwords must not be programmed again */
+            if (!fOK)
+                blank = eraseSector(0);
         }
+#endif
+        /* the copy is still intact, so fall back to single longwords */
+        if (!fOK && blank)
+            fOK = programLongwords(0, sector);
+
+        programmed = cycleCount();
+    } else {
+        erased = programmed = cycleCount();
     }
 
+#ifdef HAS_PROGRAM_SECTION
+    /* without EEE mode every later NVRam write would be lost until reset */
+    if (section)
+        eeeOK = setFlexRam(SETRAM_EEE);
+#endif
+
+    *irqOffCycles = cycleCount() - irqOff;
     __enable_irq();
 
-    return fOK;
+    /* only record once the flash is readable again */
+    recordOp(OP_FLASH_ERASE, erased - start, SECTOR_SIZE);
+    recordOp(OP_FLASH_PROGRAM, programmed - erased, SECTOR_SIZE);
+    recordOp(OP_IRQ_OFF, *irqOffCycles, 0);
+
+    if (!fOK)
+        return fasitoError(E_COULD_NOT_PROGRAM_PROT_BITS);
+
+    if (!eeeOK)
+        return fasitoErrorStr("could not switch the FlexRAM back to EEPROM");
+
+    return true;
 }
 
+#define STAGING_AREA ((const uint8_t *)STAGING_ADDR)
+#else
+/* the emulator keeps the protection bits in FTFL_FSEC and stages into RAM */
+static uint8_t stagingArea[STAGING_SIZE];
+#define STAGING_AREA stagingArea
+
+static bool writeSector(const uint32_t address, const uint32_t *data)
+{
+    memcpy(&stagingArea[address - STAGING_ADDR], data, SECTOR_SIZE);
+    return true;
+}
+
+static bool programFSEC(const uint8_t state, uint32_t *irqOffCycles)
+{
+    FTFL_FSEC = state;
+    *irqOffCycles = 0;
+    return true;
+}
+#endif
+
 static bool doSeal(bool fSeal)
 {
     Serial.print(fSeal ? "SEAL: " : "UNSEAL: ");
     Serial.print("starting to flash... "); Serial.flush();
 
-    if (!programFSEC(fSeal ? SEAL_BITS : UNSEAL_BITS))
-        return fasitoErrorStr("could not program status bits");
+    uint32_t irqOffCycles;
+    if (!programFSEC(fSeal ? SEAL_BITS : UNSEAL_BITS, &irqOffCycles))
+        return false;
 
-    Serial.println("done.");
+    Serial.print("done. Interrupts were disabled for "); Serial.print(CYCLES_TO_US(irqOffCycles)); Serial.println(" us.");
 
     return true;
 }
 
 bool sealDevice()
 {
-    if (!doSeal(true))
-        return fasitoError(E_COULD_NOT_PROGRAM_PROT_BITS);
-
-    return true;
+    return doSeal(true);
 }
 
 bool unsealDevice()
 {
-    if (!doSeal(false))
-        return fasitoError(E_COULD_NOT_PROGRAM_PROT_BITS);
+    return doSeal(false);
+}
 
-    return true;
+/* discard the rest of an aborted transfer, so it does not end up in the command parser */
+static void drainInput()
+{
+    char c[64];
+
+    Serial.setTimeout(100);
+    while (Serial.readBytes(c, sizeof(c)) > 0) ;
 }
 
-#if 0
-extern uint16_t inputBufferIndex;
+/* the staged image must at least boot: stack in RAM, reset handler in the image outside the FCF */
+static bool checkStagedVectors(const uint32_t imageSize)
+{
+    uint32_t sp, reset;
 
-static bool updateInProgress = false;
-static uint32_t flashOffset = 0;
+    memcpy(&sp, STAGING_AREA, 4);
+    memcpy(&reset, &STAGING_AREA[4], 4);
+
+    if (sp <= RAM_START || sp > RAM_END || (sp & 3))
+        return false;
 
-#define MAX_LINE_LEN 0x10
+    if (!(reset & 1))
+        return false; // not thumb code
 
-typedef struct hexLine {
-    uint8_t len;
-    uint16_t addr;
-    uint8_t type;
-    uint8_t lineData[MAX_LINE_LEN];
-} hexLine;
+    reset &= ~1;
+    return reset >= CORE_VECTORS_SIZE && reset < imageSize && (reset < FCF_ADDR || reset >= FCF_ADDR + FCF_SIZE);
+}
 
-int decodeLine(hexLine *l, const char *buf)
+/* Receives a raw binary image of imageSize bytes into the staging area and
+ * returns its SHA-256 hash. The hash is computed while receiving and checked
+ * against the staged flash contents once the transfer is complete.
+ * inputBuffer is used as sector buffer, so the command tokens are gone after this.
+ */
+bool receiveFirmware(const uint32_t imageSize, uint8_t *imageHash)
 {
-    uint8_t cnt, checksum = 0, sum = 0;
+    uint32_t *sector = (uint32_t *)inputBuffer;
+    uint32_t offset;
+    Sha256 hash;
+
+    if (imageSize <= FCF_ADDR + FCF_SIZE || imageSize > STAGING_SIZE)
+        return fasitoErrorStr("invalid image size");
 
-    if (*buf != ':')
-        return 0;
+#ifndef FASITO_EMU
+    extern unsigned long _etext, _sdata, _edata;
+    const uint32_t firmwareEnd = (uint32_t)&_etext + ((uint32_t)&_edata - (uint32_t)&_sdata);
 
-    memset(l, 0, sizeof(hexLine));
+    if (firmwareEnd > STAGING_ADDR)
+        return fasitoErrorStr("running firmware overlaps the staging area");
+#endif
 
-    parseHex(&l->len, &buf[1], 2);
+    sha256Init(&hash);
 
-    if (l->len > MAX_LINE_LEN)
-        return 0;
+    Serial.print("READY "); Serial.println(SECTOR_SIZE);
+    Serial.flush();
 
-    checksum += l->len;
+    Serial.setTimeout(RECEIVE_TIMEOUT);
+    for (offset = 0 ; offset < imageSize ; offset += SECTOR_SIZE) {
+        const uint32_t len = imageSize - offset < SECTOR_SIZE ? imageSize - offset : SECTOR_SIZE;
 
-    parseHex((uint8_t *)&l->addr, &buf[3], 4);
-    checksum += (uint8_t) l->addr;
-    checksum += (uint8_t) (l->addr >> 8);
+        /* while the previous sector was written, the USB controller kept
+         * receiving into its buffers, so this mostly drains what is queued */
+        if (Serial.readBytes(inputBuffer, len) != len) {
+            drainInput();
+            return fasitoErrorStr("firmware transfer timed out");
+        }
 
-    parseHex(&l->type, &buf[7], 2);
-    checksum += l->type;
+        sha256Update(&hash, (uint8_t *)inputBuffer, len);
+        memset(&inputBuffer[len], 0xff, SECTOR_SIZE - len);
 
-    for (cnt = 0 ; cnt < l->len ; cnt++) {
-        parseHex(&l->lineData[cnt], &buf[9 + (cnt * 2)], 2);
-        checksum += l->lineData[cnt];
+        /* no code may run from flash while the sector is written */
+        __disable_irq();
+        const uint32_t irqOff = cycleCount();
+        const bool fOK = writeSector(STAGING_ADDR + offset, sector);
+        const uint32_t irqOffCycles = cycleCount() - irqOff;
+        __enable_irq();
+
+        recordOp(OP_IRQ_OFF, irqOffCycles, 0);
+
+        if (!fOK) {
+            drainInput();
+            return fasitoErrorStr("could not program staging area");
+        }
+
+        digitalWrite(LED, (offset / SECTOR_SIZE) & 1);
     }
 
-    parseHex(&sum, &buf[9 + (l->len * 2)], 2);
+    sha256Final(&hash, imageHash);
+
+    uint8_t stagedHash[32];
+    sha256Init(&hash);
+    sha256Update(&hash, STAGING_AREA, imageSize);
+    sha256Final(&hash, stagedHash);
 
-    if ((checksum += sum) & 0xff)
-        return -1;
+    if (memcmp(imageHash, stagedHash, 32))
+        return fasitoErrorStr("staged image does not match");
 
-    return 1;
+    if (!checkStagedVectors(imageSize))
+        return fasitoErrorStr("image has no valid vector table");
+
+    return true;
 }
 
-static bool handleLine()
-{
-    int res;
-    hexLine l;
+/* outcome of the last copyStagedImage(), kept in RAM across its reset. The
+ * linker script puts it above the stack at a fixed address, so the next image
+ * finds it whatever its data and bss look like. */
+#define UPDATE_RESULT_MAGIC 0x55504454
 
-    res = decodeLine(&l, inputBuffer);
-    Serial.print("Line type: "); Serial.println(l.type);
+typedef struct UpdateResult {
+    uint32_t magic;
+    uint32_t retriedSectors;
+    uint32_t firstRetried;
+} UpdateResult;
 
-    if (!res)
-        return fasitoErrorStr("invalid line");
+static UpdateResult lastUpdate;
 
-    if (res < 0)
-        return fasitoErrorStr("checksum error");
+#ifndef FASITO_EMU
+__attribute__((section(".updateresult"))) static volatile UpdateResult updateResult;
+static_assert(sizeof(UpdateResult) <= 16, "the UPDATERESULT region of mk20dx256.ld holds 16 bytes");
 
-    if (l.type > 2) {
-        Serial.println("unsupported line type: "); Serial.print(l.type, DEC); Serial.println();
-        return false;
-    }
+FASTRUN static inline uint32_t sectorWord(const uint32_t a, const uint32_t *src, const uint32_t *config)
+{
+    return (a >= FCF_ADDR && a < FCF_ADDR + FCF_SIZE) ? config[(a - FCF_ADDR) / 4] : src[(a & (SECTOR_SIZE - 1)) / 4];
+}
 
-    if (l.type == 1) {
-        updateInProgress = false;
-        return true;
+/* compares an installed sector with the staged one, no memcmp() as that lives in flash */
+FASTRUN static bool verifySector(const uint32_t address, const uint32_t *config)
+{
+    const uint32_t *src = (const uint32_t *)(STAGING_ADDR + address);
+    const uint32_t *dst = (const uint32_t *)address;
+    int i;
+
+    for (i = 0 ; i < SECTOR_SIZE / 4 ; i++) {
+        if (dst[i] != sectorWord(address + i * 4, src, config))
+            return false;
     }
 
-    if (l.type == 2) {
-        uint16_t newOffset = 0;
-        newOffset  = l.lineData[0] << 8;
-        newOffset += l.lineData[1];
+    return true;
+}
 
-        flashOffset = newOffset << 4;
-        Serial.print(flashOffset, HEX); Serial.println();
-        return true;
-    }
+/* erases and programs one sector from the staged image, keeping the flash configuration field */
+FASTRUN static bool writeStagedSector(const uint32_t address, const uint32_t *config, const bool section)
+{
+    const uint32_t *src = (const uint32_t *)(STAGING_ADDR + address);
+    int i;
 
-#if 0
-    if (first) {
-        page = l.addr - (l.addr % SPM_PAGESIZE);
-        first = 0;
+#ifdef HAS_PROGRAM_SECTION
+    if (section) {
+        for (i = 0 ; i < SECTOR_SIZE / 4 ; i++)
+            FLEXRAM[i] = sectorWord(address + i * 4, src, config);
+
+        return eraseSector(address) && programSection(address, SECTOR_SIZE / 4);
     }
+#endif
+    if (!eraseSector(address))
+        return false;
 
-    for (cnt = 0 ; cnt < l.len ; cnt++) {
-        if ((l.addr + cnt) - ((l.addr + cnt) % SPM_PAGESIZE) != page) {
-            program_page(page, flashBuffer);
-            serialSendStr(unit, ".programmed page\r\n");
-            memset(flashBuffer, 0xFF, SPM_PAGESIZE);
-            page = (l.addr + cnt) - ((l.addr + cnt) % SPM_PAGESIZE);
-        }
+    for (i = 0 ; i < SECTOR_SIZE / 4 ; i++) {
+        const uint32_t a = address + i * 4;
+        const uint32_t value = sectorWord(a, src, config);
 
-        flashBuffer[(l.addr + cnt) % SPM_PAGESIZE] = l.lineData[cnt];
+        if (value != 0xffffffff && !programLongword(a, value))
+            return false;
     }
 
-    if (l.type == 1) {
-        program_page(page, flashBuffer);
-        serialSendStr(unit, ".programmed last page\r\n");
-        break;
-    }
-#endif
     return true;
 }
 
-bool updateFirmware()
+FASTRUN static bool copySector(const uint32_t address, const uint32_t *config, const bool section)
 {
-    int c, lineCount = 0;
-    bool ledStatus = false;
-    updateInProgress = true;
-    *inputBuffer = 0;
-    inputBufferIndex = 0;
-    flashOffset = 0;
-
-    while(updateInProgress) {
-        if (Serial.available() > 0) {
-            c = Serial.read();
-            if (c == '\n')
-                continue;
-
-            if (c == '\r') {
-                inputBuffer[inputBufferIndex] = 0; // terminate string
-                //Serial.print("["); Serial.print(inputBuffer); Serial.println("]");
-
-                if (!((lineCount++) % 200)) {
-                    ledStatus = !ledStatus;
-                    digitalWrite(LED, ledStatus);
-                }
-
-                if (inputBufferIndex > 0) {
-                    if (!handleLine()) {
-                        return false;
-                    } else {
-                        Serial.println("OK");
-                    }
-                }
-
-                *inputBuffer = 0;
-                inputBufferIndex = 0;
-                Serial.flush();
-
-                continue;
-            }
-
-            if (inputBufferIndex >= INPUT_BUFFER_SIZE)
-                inputBufferIndex = 0;
-
-            inputBuffer[inputBufferIndex++] = c;
-        } else {
-            WFI;
+    return writeStagedSector(address, config, section) && verifySector(address, config);
+}
+
+/* Copies the staged image over the running firmware and resets the MCU.
+ * Runs from RAM with interrupts disabled and must not call anything located in flash.
+ * The flash configuration field of the running firmware is kept. Every sector
+ * is rewritten until it verifies against the staging area, so the reset never
+ * runs a half-written image. Sector 0 with the vectors and the FCF goes last,
+ * until then a reset still boots the old vectors. Sectors that needed more
+ * than one attempt are recorded in updateResult for the next boot.
+ */
+FASTRUN static void copyStagedImage(const uint32_t imageSize)
+{
+    const uint32_t *fcf = (const uint32_t *)FCF_ADDR;
+    uint32_t config[FCF_SIZE / 4], address;
+    bool section = false;
+    int i;
+
+    __disable_irq();
+
+    for (i = 0 ; i < FCF_SIZE / 4 ; i++)
+        config[i] = fcf[i];
+
+    updateResult.magic = UPDATE_RESULT_MAGIC;
+    updateResult.retriedSectors = 0;
+    updateResult.firstRetried = 0;
+
+#ifdef HAS_PROGRAM_SECTION
+    /* the MCU resets afterwards, which brings the EEPROM back */
+    section = setFlexRam(SETRAM_RAM);
+#endif
+
+    for (address = SECTOR_SIZE ; ; address += SECTOR_SIZE) {
+        /* without sector 0 the part does not boot at all */
+        if (address >= imageSize)
+            address = 0;
+
+        if (!copySector(address, config, section)) {
+            if (!updateResult.retriedSectors++)
+                updateResult.firstRetried = address;
+
+            while (!copySector(address, config, section)) ;
         }
+
+        if (!address)
+            break;
     }
-    Serial.println("DONE");
-    return true;
+
+    SCB_AIRCR = 0x05FA0004; // request system reset
+    while (1) ;
+}
+
+void commitFirmware(const uint32_t imageSize)
+{
+    copyStagedImage(imageSize);
+}
+
+/* takes over the result of an update that reset the MCU */
+void checkUpdateResult()
+{
+    if (updateResult.magic != UPDATE_RESULT_MAGIC)
+        return;
+
+    lastUpdate.magic = updateResult.magic;
+    lastUpdate.retriedSectors = updateResult.retriedSectors;
+    lastUpdate.firstRetried = updateResult.firstRetried;
+    updateResult.magic = 0;
 }
 #else
-bool updateFirmware()
+void commitFirmware(const uint32_t imageSize)
+{
+    Serial.println("emulator: staged image is not installed.");
+}
+
+void checkUpdateResult()
 {
-    return false;
 }
 #endif
+
+void printUpdateResult()
+{
+    if (lastUpdate.magic != UPDATE_RESULT_MAGIC)
+        return;
+
+    Serial.print("Last update       : ");
+    if (!lastUpdate.retriedSectors) {
+        Serial.println("OK");
+        return;
+    }
+
+    char line[80];
+    sprintf(line, "OK, %lu sector(s) rewritten, first at 0x%08lx", (unsigned long)lastUpdate.retriedSectors,
+            (unsigned long)lastUpdate.firstRetried);
+    Serial.println(line);
+}
@@ -21,7 +21,10 @@
 #ifndef SRC_UPDATE_H_
 #define SRC_UPDATE_H_
 
-extern bool updateFirmware();
+extern bool receiveFirmware(const uint32_t imageSize, uint8_t *imageHash);
+extern void commitFirmware(const uint32_t imageSize);
+extern void checkUpdateResult();
+extern void printUpdateResult();
 extern bool sealDevice();
 extern bool unsealDevice();
 
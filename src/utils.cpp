@@ -20,46 +20,77 @@
 
 #include "Arduino.h"
 #include "fasito.h"
+#include "utils.h"
 #include "fasito_error.h"
+#include "nvram.h"
+#include "opstats.h"
+#include "cmdstats.h"
 
 FasitoNVRam nvram;
 char *commandTokens[MAX_TOKEN];
+uint8_t encoding = ENC_HEX;
+const char *encodingNames[NUM_ENCODINGS] = { "HEX", "BASE64" };
+
+static const char base64Digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
 bool fasitoErrorStr(const char *errorStr)
 {
+    recordError(E_OTHER);
     strcpy(inputBuffer, errorStr);
     return false;
 }
 
 bool fasitoError(uint8_t errorNo)
 {
+    recordError(errorNo);
     strcpy(inputBuffer, errorStrings[errorNo]);
     return false;
 }
 
 bool fasitoError(uint8_t errorNo, int arg)
 {
+    recordError(errorNo);
     sprintf(inputBuffer, errorStrings[errorNo], arg);
     return false;
 }
 
-void printHex(const uint8_t *buf, const size_t len, const bool addLF = false)
+static const char hexDigits[] = "0123456789abcdef";
+
+/* encodes straight into the USB transmit packets, see usb_serial_write_reserve() */
+HOTRUN void printHex(const uint8_t *buf, const size_t len, const bool addLF)
 {
-    size_t i;
-    char c[3], text[len * 2];
+    const size_t nNibbles = len * 2;
+    size_t i = 0;
 
-    *text=0;
-    for (i = 0; i < len; i++) {
-        sprintf(c, "%02x", buf[i]);
-        strcat(text, c);
-    }
+    while (i < nNibbles) {
+        uint8_t *dst;
+        uint32_t n = usb_serial_write_reserve(&dst);
+
+        if (!n)
+            break; // nobody listening, dropped like Serial.print() does
+
+        if (n > nNibbles - i)
+            n = nNibbles - i;
 
-    //Serial.print((uint32_t)buf, HEX); Serial.print(": ");
+        for (uint32_t j = 0 ; j < n ; j++, i++)
+            dst[j] = hexDigits[(i & 1) ? buf[i >> 1] & 0x0f : buf[i >> 1] >> 4];
+
+        usb_serial_write_commit(n);
+    }
 
     if (addLF)
-        Serial.println(text);
-    else
-        Serial.print(text);
+        Serial.println();
+}
+
+/* the same encoding into out, which needs room for len * 2 + 1 chars */
+HOTRUN void encodeHex(char *out, const uint8_t *buf, const size_t len)
+{
+    for (size_t i = 0 ; i < len ; i++) {
+        out[i * 2] = hexDigits[buf[i] >> 4];
+        out[i * 2 + 1] = hexDigits[buf[i] & 0x0f];
+    }
+
+    out[len * 2] = 0;
 }
 
 static const int8_t char2nibble(char c)
@@ -74,7 +105,7 @@ static const int8_t char2nibble(char c)
     return -1;
 }
 
-bool parseHex(uint8_t *out, const char *in, size_t outLen)
+HOTRUN bool parseHex(uint8_t *out, const char *in, size_t outLen)
 {
     size_t i;
 
@@ -90,8 +121,120 @@ bool parseHex(uint8_t *out, const char *in, size_t outLen)
     return true;
 }
 
+/* like printHex(), one output character at a time into the USB transmit packets */
+static void printBase64(const uint8_t *buf, const size_t len)
+{
+    const size_t nChars = BASE64_LENGTH(len);
+    size_t i = 0;
+
+    while (i < nChars) {
+        uint8_t *dst;
+        uint32_t n = usb_serial_write_reserve(&dst);
+
+        if (!n)
+            break;
+
+        if (n > nChars - i)
+            n = nChars - i;
+
+        for (uint32_t j = 0 ; j < n ; j++, i++) {
+            const size_t k = (i >> 2) * 3;
+            const uint8_t pos = i & 3;
+
+            if (pos > 1 && k + pos - 1 >= len) {
+                dst[j] = '=';
+                continue;
+            }
+
+            const uint32_t v = (buf[k] << 16) | (k + 1 < len ? buf[k + 1] << 8 : 0) | (k + 2 < len ? buf[k + 2] : 0);
+            dst[j] = base64Digits[(v >> (18 - 6 * pos)) & 0x3f];
+        }
+
+        usb_serial_write_commit(n);
+    }
+}
+
+static int8_t char2sextet(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    else if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    else if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    else if (c == '+')
+        return 62;
+    else if (c == '/')
+        return 63;
+
+    return -1;
+}
+
+/* in holds BASE64_LENGTH(outLen) characters, padded with '=' */
+static bool parseBase64(uint8_t *out, const char *in, size_t outLen)
+{
+    size_t i;
+
+    for (i = 0 ; i < outLen ; i += 3, in += 4) {
+        uint32_t v = 0;
+        uint8_t j;
+
+        for (j = 0 ; j < 4 ; j++) {
+            /* only the padding after the last byte may be '=' */
+            if (i + j > outLen) {
+                if (in[j] != '=')
+                    return false;
+                v <<= 6;
+                continue;
+            }
+
+            const int8_t sextet = char2sextet(in[j]);
+            if (sextet < 0)
+                return false;
+            v = (v << 6) | sextet;
+        }
+
+        /* the bits of the last sextet past the end must be zero */
+        if ((i + 1 >= outLen && (v & 0xff00)) || (i + 2 >= outLen && (v & 0xff)))
+            return false;
+
+        out[i] = v >> 16;
+        if (i + 1 < outLen)
+            out[i + 1] = v >> 8;
+        if (i + 2 < outLen)
+            out[i + 2] = v;
+    }
+
+    return true;
+}
+
+/* binary reply values (signatures, nonces, keys) in the session's encoding */
+HOTRUN void printValue(const uint8_t *buf, const size_t len, const bool addLF)
+{
+    if (encoding == ENC_BASE64) {
+        printBase64(buf, len);
+    } else {
+        printHex(buf, len);
+    }
+
+    if (addLF)
+        Serial.println();
+}
+
+/* a binary argument of outLen bytes in the session's encoding */
+HOTRUN bool parseValue(uint8_t *out, const char *in, size_t outLen)
+{
+    if (!in)
+        return false;
+
+    if (encoding == ENC_HEX)
+        return strlen(in) == outLen * 2 && parseHex(out, in, outLen);
+
+    return strlen(in) == BASE64_LENGTH(outLen) && parseBase64(out, in, outLen);
+}
+
 /* buf must be NULL terminated */
-const char **tokenise(char *buf, uint8_t *nTokens)
+HOTRUN const char **tokenise(char *buf, uint8_t *nTokens)
 {
     if (!buf || !*buf || *buf != ' ' || !buf[1]) {
         nTokens = 0;
@@ -124,28 +267,6 @@ const char **tokenise(char *buf, uint8_t *nTokens)
     return (const char **)commandTokens;
 }
 
-static void crc16_update(uint16_t &crc, uint8_t data)
-{
-    unsigned int i;
-
-    crc ^= data;
-    for (i = 0; i < 8; ++i) {
-        if (crc & 1)
-            crc = (crc >> 1) ^ 0xA001;
-        else
-            crc = crc >> 1;
-    }
-}
-
-static uint16_t checkCRC16(uint8_t *data, uint16_t len)
-{
-    uint16_t i, crc = 0;
-    for (i = 0 ; i < len ; i++)
-        crc16_update(crc, data[i]);
-
-    return crc;
-}
-
 void reverseBytes(uint8_t *buf, size_t len)
 {
     size_t i;
@@ -179,18 +300,49 @@ bool comparePins(const UserPIN *userPin, const char *pin)
     return true;
 }
 
-bool readEEPROM(FasitoNVRam *dst)
+void writeEEPROM(FasitoNVRam *dst)
 {
-    eeprom_read_block(dst, 0, sizeof(FasitoNVRam));
-    return dst->checksum == checkCRC16((uint8_t *)dst, sizeof(FasitoNVRam) - 2);
+    const uint32_t start = cycleCount(), bytes = eeprom_stats.bytes;
+
+    nvramUpdateColdChecksum((uint8_t *)dst);
+    nvramUpdateHotChecksum((uint8_t *)dst);
+    eeprom_write_block(dst, 0, sizeof(FasitoNVRam));
+
+    recordOp(OP_NVRAM_WRITE, cycleCount() - start, eeprom_stats.bytes - bytes);
 }
 
-void writeEEPROM(FasitoNVRam *dst)
+/* only writes the PIN state and counters */
+void writeHotEEPROM(FasitoNVRam *dst)
 {
-    //Serial.print("FasitoNVRam length: "); Serial.print(sizeof(FasitoNVRam)); Serial.println();
-    dst->checksum = checkCRC16((uint8_t *)dst, sizeof(FasitoNVRam) - 2);
-    //Serial.print(dst->checksum, HEX); Serial.println();
-    eeprom_write_block(dst, 0, sizeof(FasitoNVRam));
+    const uint32_t start = cycleCount(), bytes = eeprom_stats.bytes;
+
+    nvramUpdateHotChecksum((uint8_t *)dst);
+    eeprom_write_block(&dst->userPin, (void *)NVRAM_HOT_OFFSET, NVRAM_HOT_SIZE);
+
+    recordOp(OP_NVRAM_HOT_WRITE, cycleCount() - start, eeprom_stats.bytes - bytes);
+}
+
+bool readEEPROM(FasitoNVRam *dst)
+{
+    uint32_t image[(NVRAM_MAX_IMAGE_SIZE + 3) / 4];
+    const uint32_t start = cycleCount();
+
+    eeprom_read_block(image, 0, NVRAM_MAX_IMAGE_SIZE);
+    recordOp(OP_NVRAM_READ, cycleCount() - start, 0);
+
+    const int res = migrateNVRam((uint8_t *)image);
+    if (res == NVRAM_INVALID)
+        return false;
+
+    memcpy(dst, image, sizeof(FasitoNVRam));
+    memset(image, 0, sizeof(image));
+
+    if (res == NVRAM_MIGRATED) {
+        Serial.print("NVRam migrated to config version "); Serial.println(dst->version);
+        writeEEPROM(dst);
+    }
+
+    return true;
 }
 
 #ifndef FASITO_EMU
@@ -27,18 +27,33 @@
 #define pHEX(a, b, l) { Serial.print(a ": "); printHex(b, l, true); }
 #define LED 13
 #ifdef FASITO_EMU
-# define WFI
+# define WFI emuWaitForInput()
 #else
 # define WFI asm("wfi")
 #endif
 
 extern FasitoNVRam nvram;
 
+/* encoding of binary reply values and arguments, set per session by ENCODE */
+enum {
+    ENC_HEX,
+    ENC_BASE64,
+    NUM_ENCODINGS
+};
+extern uint8_t encoding;
+extern const char *encodingNames[];
+
+#define BASE64_LENGTH(len) ((((len) + 2) / 3) * 4)
+
 extern void printHex(const uint8_t *buf, const size_t len, const bool addLF = false);
+extern void encodeHex(char *out, const uint8_t *buf, const size_t len);
 extern bool parseHex(uint8_t *out, const char *in, size_t len);
+extern void printValue(const uint8_t *buf, const size_t len, const bool addLF = false);
+extern bool parseValue(uint8_t *out, const char *in, size_t len);
 extern const char **tokenise(char *buf, uint8_t *nTokens);
 extern bool readEEPROM(FasitoNVRam *dst);
 extern void writeEEPROM(FasitoNVRam *dst);
+extern void writeHotEEPROM(FasitoNVRam *dst);
 extern bool fasitoErrorStr(const char *errorStr);
 extern bool fasitoError(uint8_t errorNo);
 extern bool fasitoError(uint8_t errorNo, int arg);
@@ -28,6 +28,8 @@
 #define STR(s) STR_NAME(s)
 #define __FASITO_VERSION__ "v" STR(__FASITO_VERSION_MAJOR__) "." STR(__FASITO_VERSION_MINOR__)
 
-#define CONFIG_VERSION 1
+/* layout version of FasitoNVRam. When bumping it, add the previous
+ * layout and its upgrade step to the table in nvram.cpp */
+#define CONFIG_VERSION 2
 
 #endif /* VERSION_H_ */
@@ -38,4 +38,24 @@
   #define E2END 0
 #endif
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// statistics of the FlexRAM writes which actually changed data,
+// times are in cycles of F_CPU, whatever the core clock was
+struct eeprom_stats {
+	uint32_t count;
+	uint32_t last;
+	uint32_t min;
+	uint32_t max;
+	uint32_t bytes;
+};
+
+extern struct eeprom_stats eeprom_stats;
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif
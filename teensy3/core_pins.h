@@ -1544,6 +1544,14 @@ static inline uint32_t millis(void)
 
 uint32_t micros(void);
 
+// the core clock in Hz, it only differs from F_CPU with ENABLE_CLOCK_SCALING,
+// which changes the core clock divider at runtime
+#ifdef ENABLE_CLOCK_SCALING
+extern volatile uint32_t F_CPU_ACTUAL;
+#else
+#define F_CPU_ACTUAL F_CPU
+#endif
+
 static inline void delayMicroseconds(uint32_t) __attribute__((always_inline, unused));
 static inline void delayMicroseconds(uint32_t usec)
 {
@@ -29,6 +29,7 @@
  */
 
 #include "kinetis.h"
+#include "core_pins.h"
 #include <avr/eeprom.h>
 //#include "HardwareSerial.h"
 
@@ -176,11 +177,25 @@ int eeprom_is_ready(void)
 	return (FTFL_FCNFG & FTFL_FCNFG_EEERDY) ? 1 : 0;
 }
 
-static void flexram_wait(void)
+struct eeprom_stats eeprom_stats;
+
+// the wait time is measured with the DWT cycle counter, which
+// needs to be enabled by the application, and kept in cycles of
+// F_CPU so that waits at a scaled down clock stay comparable
+static void flexram_wait(uint32_t bytes)
 {
+	uint32_t cycles = ARM_DWT_CYCCNT;
+
 	while (!(FTFL_FCNFG & FTFL_FCNFG_EEERDY)) {
 		// TODO: timeout
 	}
+	cycles = (ARM_DWT_CYCCNT - cycles) * (F_CPU / F_CPU_ACTUAL);
+
+	if (!eeprom_stats.count || cycles < eeprom_stats.min) eeprom_stats.min = cycles;
+	if (cycles > eeprom_stats.max) eeprom_stats.max = cycles;
+	eeprom_stats.last = cycles;
+	eeprom_stats.count++;
+	eeprom_stats.bytes += bytes;
 }
 
 void eeprom_write_byte(uint8_t *addr, uint8_t value)
@@ -193,7 +208,7 @@ void eeprom_write_byte(uint8_t *addr, uint8_t value)
 		uint8_t stat = FTFL_FSTAT & 0x70;
 		if (stat) FTFL_FSTAT = stat;
 		FlexRAM[offset] = value;
-		flexram_wait();
+		flexram_wait(1);
 	}
 }
 
@@ -210,7 +225,7 @@ void eeprom_write_word(uint16_t *addr, uint16_t value)
 			uint8_t stat = FTFL_FSTAT & 0x70;
 			if (stat) FTFL_FSTAT = stat;
 			*(uint16_t *)(&FlexRAM[offset]) = value;
-			flexram_wait();
+			flexram_wait(2);
 		}
 #ifdef HANDLE_UNALIGNED_WRITES
 	} else {
@@ -218,13 +233,13 @@ void eeprom_write_word(uint16_t *addr, uint16_t value)
 			uint8_t stat = FTFL_FSTAT & 0x70;
 			if (stat) FTFL_FSTAT = stat;
 			FlexRAM[offset] = value;
-			flexram_wait();
+			flexram_wait(1);
 		}
 		if (FlexRAM[offset + 1] != (value >> 8)) {
 			uint8_t stat = FTFL_FSTAT & 0x70;
 			if (stat) FTFL_FSTAT = stat;
 			FlexRAM[offset + 1] = value >> 8;
-			flexram_wait();
+			flexram_wait(1);
 		}
 	}
 #endif
@@ -244,7 +259,7 @@ void eeprom_write_dword(uint32_t *addr, uint32_t value)
 			uint8_t stat = FTFL_FSTAT & 0x70;
 			if (stat) FTFL_FSTAT = stat;
 			*(uint32_t *)(&FlexRAM[offset]) = value;
-			flexram_wait();
+			flexram_wait(4);
 		}
 		return;
 #ifdef HANDLE_UNALIGNED_WRITES
@@ -253,13 +268,13 @@ void eeprom_write_dword(uint32_t *addr, uint32_t value)
 			uint8_t stat = FTFL_FSTAT & 0x70;
 			if (stat) FTFL_FSTAT = stat;
 			*(uint16_t *)(&FlexRAM[offset]) = value;
-			flexram_wait();
+			flexram_wait(2);
 		}
 		if (*(uint16_t *)(&FlexRAM[offset + 2]) != (value >> 16)) {
 			uint8_t stat = FTFL_FSTAT & 0x70;
 			if (stat) FTFL_FSTAT = stat;
 			*(uint16_t *)(&FlexRAM[offset + 2]) = value >> 16;
-			flexram_wait();
+			flexram_wait(2);
 		}
 		return;
 	default:
@@ -267,19 +282,19 @@ void eeprom_write_dword(uint32_t *addr, uint32_t value)
 			uint8_t stat = FTFL_FSTAT & 0x70;
 			if (stat) FTFL_FSTAT = stat;
 			FlexRAM[offset] = value;
-			flexram_wait();
+			flexram_wait(1);
 		}
 		if (*(uint16_t *)(&FlexRAM[offset + 1]) != (value >> 8)) {
 			uint8_t stat = FTFL_FSTAT & 0x70;
 			if (stat) FTFL_FSTAT = stat;
 			*(uint16_t *)(&FlexRAM[offset + 1]) = value >> 8;
-			flexram_wait();
+			flexram_wait(2);
 		}
 		if (FlexRAM[offset + 3] != (value >> 24)) {
 			uint8_t stat = FTFL_FSTAT & 0x70;
 			if (stat) FTFL_FSTAT = stat;
 			FlexRAM[offset + 3] = value >> 24;
-			flexram_wait();
+			flexram_wait(1);
 		}
 	}
 #endif
@@ -307,7 +322,7 @@ void eeprom_write_block(const void *buf, void *addr, uint32_t len)
 				uint8_t stat = FTFL_FSTAT & 0x70;
 				if (stat) FTFL_FSTAT = stat;
 				*(uint32_t *)(&FlexRAM[offset]) = val32;
-				flexram_wait();
+				flexram_wait(4);
 			}
 			offset += 4;
 			len -= 4;
@@ -320,7 +335,7 @@ void eeprom_write_block(const void *buf, void *addr, uint32_t len)
 				uint8_t stat = FTFL_FSTAT & 0x70;
 				if (stat) FTFL_FSTAT = stat;
 				*(uint16_t *)(&FlexRAM[offset]) = val16;
-				flexram_wait();
+				flexram_wait(2);
 			}
 			offset += 2;
 			len -= 2;
@@ -331,7 +346,7 @@ void eeprom_write_block(const void *buf, void *addr, uint32_t len)
 				uint8_t stat = FTFL_FSTAT & 0x70;
 				if (stat) FTFL_FSTAT = stat;
 				FlexRAM[offset] = val8;
-				flexram_wait();
+				flexram_wait(1);
 			}
 			offset++;
 			len--;
@@ -794,7 +794,11 @@ enum IRQ_NUMBER_t {
  #define F_BUS 48000000
  //#define F_BUS 72000000
  #endif
+ #if defined(ENABLE_CLOCK_SCALING)
+ #define F_MEM 24000000	// the core clock must stay a multiple of it at 144 / 3 MHz
+ #else
  #define F_MEM 28800000
+ #endif
 #elif (F_CPU == 120000000)
  #define F_PLL 120000000
  #ifndef F_BUS
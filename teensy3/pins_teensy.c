@@ -597,7 +597,11 @@ void _init_Teensyduino_internal_(void)
 	//analog_init();
 	// for background about this startup delay, please see this conversation
 	// https://forum.pjrc.com/threads/31290-Teensey-3-2-Teensey-Loader-1-24-Issues?p=87273&viewfull=1#post87273
-	delay(400);
+	// Fasito: make FASTBOOT=1 shortens it, uploads are rare on a token
+#ifndef TEENSY_INIT_USB_DELAY_BEFORE
+#define TEENSY_INIT_USB_DELAY_BEFORE 400
+#endif
+	delay(TEENSY_INIT_USB_DELAY_BEFORE);
 	usb_init();
 }
 
@@ -1106,13 +1110,19 @@ uint8_t shiftIn_msbFirst(uint8_t dataPin, uint8_t clockPin)
 // the systick interrupt is supposed to increment this at 1 kHz rate
 volatile uint32_t systick_millis_count = 0;
 
+#ifdef ENABLE_CLOCK_SCALING
+// SYST_RVR is reprogrammed whenever this changes, see F_CPU_ACTUAL in core_pins.h
+volatile uint32_t F_CPU_ACTUAL = F_CPU;
+#endif
+
 //uint32_t systick_current, systick_count, systick_istatus;  // testing only
 
 uint32_t micros(void)
 {
-	uint32_t count, current, istatus;
+	uint32_t count, current, istatus, f_cpu;
 
 	__disable_irq();
+	f_cpu = F_CPU_ACTUAL;
 	current = SYST_CVR;
 	count = systick_millis_count;
 	istatus = SCB_ICSR;	// bit 26 indicates if systick exception pending
@@ -1121,13 +1131,13 @@ uint32_t micros(void)
 	 //systick_count = count;
 	 //systick_istatus = istatus & SCB_ICSR_PENDSTSET ? 1 : 0;
 	if ((istatus & SCB_ICSR_PENDSTSET) && current > 50) count++;
-	current = ((F_CPU / 1000) - 1) - current;
+	current = ((f_cpu / 1000) - 1) - current;
 #if defined(KINETISL) && F_CPU == 48000000
 	return count * 1000 + ((current * (uint32_t)87381) >> 22);
 #elif defined(KINETISL) && F_CPU == 24000000
 	return count * 1000 + ((current * (uint32_t)174763) >> 22);
 #endif
-	return count * 1000 + current / (F_CPU / 1000000);
+	return count * 1000 + current / (f_cpu / 1000000);
 }
 
 void delay(uint32_t ms)
@@ -127,7 +127,11 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
 #endif
   #define EP0_SIZE		64
   #define NUM_ENDPOINTS		4
+  // NUM_USB_BUFFERS, CDC_RX_SIZE, CDC_TX_SIZE and TX_PACKET_LIMIT can be set at build time,
+  // see the checks in usb_mem.c and usb_serial.c
+  #ifndef NUM_USB_BUFFERS
   #define NUM_USB_BUFFERS	12
+  #endif
   #define NUM_INTERFACE		2
   #define CDC_STATUS_INTERFACE	0
   #define CDC_DATA_INTERFACE	1
@@ -135,8 +139,20 @@ let me know?  http://forum.pjrc.com/forums/4-Suggestions-amp-Bug-Reports
   #define CDC_RX_ENDPOINT       3
   #define CDC_TX_ENDPOINT       4
   #define CDC_ACM_SIZE          16
+  #ifndef CDC_RX_SIZE
   #define CDC_RX_SIZE           64
+  #endif
+  #ifndef CDC_TX_SIZE
   #define CDC_TX_SIZE           64
+  #endif
+  // maximum number of transmit packets to queue so we don't starve other endpoints for memory
+  #ifndef TX_PACKET_LIMIT
+  #define TX_PACKET_LIMIT       8
+  #endif
+  // bytes of the ring the receive interrupt assembles command lines in, a power of 2
+  #ifndef USB_SERIAL_LINE_BUFFER
+  #define USB_SERIAL_LINE_BUFFER 2048
+  #endif
   #define ENDPOINT2_CONFIG	ENDPOINT_TRANSIMIT_ONLY
   #define ENDPOINT3_CONFIG	ENDPOINT_RECEIVE_ONLY
   #define ENDPOINT4_CONFIG	ENDPOINT_TRANSIMIT_ONLY
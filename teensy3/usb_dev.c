@@ -776,6 +776,7 @@ void usb_tx(uint32_t endpoint, usb_packet_t *packet)
 	endpoint--;
 	if (endpoint >= NUM_ENDPOINTS) return;
 	__disable_irq();
+	usb_stats.tx_packets++;
 	//serial_print("txstate=");
 	//serial_phex(tx_state[endpoint]);
 	//serial_print("\n");
@@ -801,6 +802,7 @@ void usb_tx(uint32_t endpoint, usb_packet_t *packet)
 			tx_last[endpoint]->next = packet;
 		}
 		tx_last[endpoint] = packet;
+		usb_stats.tx_queued++;
 		__enable_irq();
 		return;
 	}
@@ -978,6 +980,14 @@ void usb_isr(void)
 				}
 			} else { // receive
 				packet->len = b->desc >> 16;
+#ifdef CDC_DATA_INTERFACE
+				if (packet->len > 0 && endpoint == CDC_RX_ENDPOINT - 1 &&
+				  rx_first[endpoint] == NULL && usb_serial_rx_isr(packet)) {
+					// the line buffer took the bytes, receive into the same packet
+					usb_stats.rx_packets++;
+					b->desc = BDT_DESC(64, ((uint32_t)b & 8) ? DATA1 : DATA0);
+				} else
+#endif
 				if (packet->len > 0) {
 					packet->index = 0;
 					packet->next = NULL;
@@ -998,6 +1008,7 @@ void usb_isr(void)
 					}
 					rx_last[endpoint] = packet;
 					usb_rx_byte_count_data[endpoint] += packet->len;
+					usb_stats.rx_packets++;
 					// TODO: implement a per-endpoint maximum # of allocated
 					// packets, so a flood of incoming data on 1 endpoint
 					// doesn't starve the others if the user isn't reading
@@ -1012,6 +1023,7 @@ void usb_isr(void)
 						//serial_phex(endpoint + 1);
 						b->desc = 0;
 						usb_rx_memory_needed++;
+						usb_stats.rx_starved++;
 					}
 				} else {
 					b->desc = BDT_DESC(64, ((uint32_t)b & 8) ? DATA1 : DATA0);
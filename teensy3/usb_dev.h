@@ -74,6 +74,7 @@ extern volatile uint32_t systick_millis_count;
 extern volatile uint8_t usb_cdc_line_rtsdtr;
 extern volatile uint8_t usb_cdc_transmit_flush_timer;
 extern void usb_serial_flush_callback(void);
+extern int usb_serial_rx_isr(const usb_packet_t *packet);
 #endif
 
 #ifdef SEREMU_INTERFACE
@@ -35,9 +35,20 @@
 //#include "HardwareSerial.h"
 #include "usb_mem.h"
 
+// usb_buffer_available is a 32 bit mask
+#if NUM_USB_BUFFERS > 32
+#error "NUM_USB_BUFFERS must not exceed 32"
+#endif
+
+_Static_assert(sizeof(usb_packet_t) == USB_PACKET_BYTES, "USB_PACKET_BYTES does not match usb_packet_t");
+_Static_assert(NUM_USB_BUFFERS * sizeof(usb_packet_t) <= USB_BUFFER_RAM_BUDGET,
+	"NUM_USB_BUFFERS exceeds USB_BUFFER_RAM_BUDGET");
+
 __attribute__ ((section(".usbbuffers"), used))
 unsigned char usb_buffer_memory[NUM_USB_BUFFERS * sizeof(usb_packet_t)];
 
+volatile struct usb_stats usb_stats;
+
 static uint32_t usb_buffer_available = 0xFFFFFFFF;
 
 // use bitmask and CLZ instruction to implement fast free list
@@ -54,6 +65,7 @@ usb_packet_t * usb_malloc(void)
 	avail = usb_buffer_available;
 	n = __builtin_clz(avail); // clz = count leading zeros
 	if (n >= NUM_USB_BUFFERS) {
+		usb_stats.malloc_failed++;
 		__enable_irq();
 		return NULL;
 	}
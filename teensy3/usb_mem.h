@@ -40,10 +40,30 @@ typedef struct usb_packet_struct {
 	uint8_t buf[64];
 } usb_packet_t;
 
+// RAM budget of the packet buffers (make USB_RAM_BUDGET=...), checked in usb_mem.c
+#define USB_PACKET_BYTES	72
+#ifndef USB_BUFFER_RAM_BUDGET
+#define USB_BUFFER_RAM_BUDGET	(24 * USB_PACKET_BYTES)
+#endif
+
+// statistics of the USB transfers, counted by usb_dev.c, usb_mem.c and usb_serial.c
+struct usb_stats {
+	uint32_t rx_packets;
+	uint32_t rx_starved;	// no buffer to re-arm a receive endpoint (usb_rx_memory_needed)
+	uint32_t tx_packets;
+	uint32_t tx_queued;	// both transmit descriptors busy, the packet waits in the queue
+	uint32_t tx_waits;	// wait loops of usb_serial_write() for a transmit packet
+	uint32_t tx_timeouts;
+	uint32_t tx_zlps;	// zero length packets ending a transfer after a full packet
+	uint32_t malloc_failed;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+extern volatile struct usb_stats usb_stats;
+
 usb_packet_t * usb_malloc(void);
 void usb_free(usb_packet_t *p);
 
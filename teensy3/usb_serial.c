@@ -46,8 +46,146 @@ volatile uint8_t usb_cdc_transmit_flush_timer=0;
 static usb_packet_t *rx_packet=NULL;
 static usb_packet_t *tx_packet=NULL;
 static volatile uint8_t tx_noautoflush=0;
+static volatile uint8_t tx_zlp_needed=0;	// the last packet sent was full, the host waits for a short one
 
 #define TRANSMIT_FLUSH_TIMEOUT	5   /* in milliseconds */
+static volatile uint8_t transmit_flush_timeout=TRANSMIT_FLUSH_TIMEOUT;
+
+// Line assembly: the receive interrupt copies packets of the CDC data endpoint
+// into this ring and counts the '\r' terminated lines, so the main program only
+// has to look at usb_serial_readline() when it wakes up. The ring holds the
+// oldest received bytes, followed by rx_packet and the endpoint's queue, all
+// the read functions below take from it first.
+#if USB_SERIAL_LINE_BUFFER & (USB_SERIAL_LINE_BUFFER - 1)
+#error "USB_SERIAL_LINE_BUFFER must be a power of 2"
+#endif
+
+static uint8_t line_buffer[USB_SERIAL_LINE_BUFFER];
+static volatile uint32_t line_head=0;	// written by line_append()
+static volatile uint32_t line_tail=0;	// written by the readers
+static volatile uint16_t line_count=0;	// complete lines in the ring
+static volatile uint8_t line_skip=0;	// drop the rest of a line that did not fit
+static volatile uint8_t line_filling=0;	// the main program takes packets from the queue
+
+static inline uint32_t line_bytes(void)
+{
+	return line_head - line_tail;
+}
+
+static void line_append(const uint8_t *p, uint32_t len)
+{
+	uint32_t head = line_head;
+	uint16_t lines = 0;
+
+	while (len-- > 0) {
+		uint8_t c = *p++;
+		if (line_skip) {
+			if (c == '\r') line_skip = 0;
+			continue;
+		}
+		line_buffer[head++ & (USB_SERIAL_LINE_BUFFER - 1)] = c;
+		if (c == '\r') lines++;
+	}
+	line_head = head;
+	line_count += lines;
+}
+
+// take one byte from the ring, the caller checked line_bytes()
+static int line_pop(void)
+{
+	uint8_t c = line_buffer[line_tail & (USB_SERIAL_LINE_BUFFER - 1)];
+
+	line_tail++;
+	if (c == '\r') {
+		__disable_irq();
+		line_count--;
+		__enable_irq();
+	}
+	return c;
+}
+
+// called by usb_isr() for every packet of the CDC data endpoint while the
+// endpoint's queue is empty; returns 1 if the bytes went into the ring, the
+// packet can then receive again
+int usb_serial_rx_isr(const usb_packet_t *packet)
+{
+	if (rx_packet || line_filling) return 0;
+	if (USB_SERIAL_LINE_BUFFER - line_bytes() < packet->len) return 0;
+	line_append(packet->buf, packet->len);
+	return 1;
+}
+
+// move what the interrupt had to queue, because the ring was full, into the ring
+static void line_fill(void)
+{
+	usb_packet_t *p;
+
+	if (!usb_configuration) return;
+	line_filling = 1;
+	if (rx_packet && USB_SERIAL_LINE_BUFFER - line_bytes() >= rx_packet->len - rx_packet->index) {
+		line_append(rx_packet->buf + rx_packet->index, rx_packet->len - rx_packet->index);
+		usb_free(rx_packet);
+		rx_packet = NULL;
+	}
+	while (!rx_packet && usb_rx_byte_count(CDC_RX_ENDPOINT) > 0) {
+		p = usb_rx(CDC_RX_ENDPOINT);
+		if (!p) break;
+		if (USB_SERIAL_LINE_BUFFER - line_bytes() < p->len) {
+			rx_packet = p;	// read by usb_serial_getchar() once the ring has room
+			break;
+		}
+		line_append(p->buf, p->len);
+		usb_free(p);
+	}
+	line_filling = 0;
+}
+
+// copy the next complete line without its '\r' to buffer and terminate it,
+// returns its length or -1 if no line is complete yet. A line longer than the
+// ring or buffer is dropped up to its '\r' and USB_SERIAL_LINE_TOO_LONG returned.
+int usb_serial_readline(char *buffer, uint32_t size)
+{
+	uint32_t n = 0, avail;
+	uint8_t cut = 0;
+	int c = 0;
+
+	line_fill();
+	if (!line_count) {
+		if (line_bytes() < USB_SERIAL_LINE_BUFFER) return -1;
+		line_skip = 1;
+		cut = 1;
+	}
+	// only look at what is there now, the interrupt may append the next line
+	avail = line_bytes();
+	while (avail-- > 0) {
+		c = line_pop();
+		if (c == '\r') break;
+		if (n < size - 1) buffer[n++] = c;
+		else cut = 1;
+	}
+	if (cut) n = 0;
+	buffer[n] = 0;
+	return cut ? USB_SERIAL_LINE_TOO_LONG : (int)n;
+}
+
+// take the next queued packet as rx_packet, keeping the interrupt from putting
+// newer bytes into the ring until rx_packet is set. Returns NULL without
+// dequeuing if the interrupt filled the ring after the caller found it empty,
+// those bytes are older than the queue and the caller has to read them first.
+static usb_packet_t *rx_next(void)
+{
+	__disable_irq();
+	line_filling = 1;
+	if (line_bytes() > 0) {
+		line_filling = 0;
+		__enable_irq();
+		return NULL;
+	}
+	__enable_irq();
+	rx_packet = usb_rx(CDC_RX_ENDPOINT);
+	line_filling = 0;
+	return rx_packet;
+}
 
 // get the next character, or -1 if nothing received
 int usb_serial_getchar(void)
@@ -55,10 +193,10 @@ int usb_serial_getchar(void)
 	unsigned int i;
 	int c;
 
+	if (line_bytes() > 0) return line_pop();
 	if (!rx_packet) {
 		if (!usb_configuration) return -1;
-		rx_packet = usb_rx(CDC_RX_ENDPOINT);
-		if (!rx_packet) return -1;
+		if (!rx_next()) return line_bytes() > 0 ? line_pop() : -1;
 	}
 	i = rx_packet->index;
 	c = rx_packet->buf[i++];
@@ -74,12 +212,11 @@ int usb_serial_getchar(void)
 // peek at the next character, or -1 if nothing received
 int usb_serial_peekchar(void)
 {
+	if (line_bytes() > 0) return line_buffer[line_tail & (USB_SERIAL_LINE_BUFFER - 1)];
 	if (!rx_packet) {
 		if (!usb_configuration) return -1;
-		rx_packet = usb_rx(CDC_RX_ENDPOINT);
-		if (!rx_packet) return -1;
+		if (!rx_next()) return line_bytes() > 0 ? line_buffer[line_tail & (USB_SERIAL_LINE_BUFFER - 1)] : -1;
 	}
-	if (!rx_packet) return -1;
 	return rx_packet->buf[rx_packet->index];
 }
 
@@ -87,7 +224,7 @@ int usb_serial_peekchar(void)
 int usb_serial_available(void)
 {
 	int count;
-	count = usb_rx_byte_count(CDC_RX_ENDPOINT);
+	count = usb_rx_byte_count(CDC_RX_ENDPOINT) + line_bytes();
 	if (rx_packet) count += rx_packet->len - rx_packet->index;
 	return count;
 }
@@ -99,13 +236,22 @@ int usb_serial_read(void *buffer, uint32_t size)
 	uint32_t qty, count=0;
 
 	while (size) {
+		if (line_bytes() > 0) {
+			*p++ = line_pop();
+			count++;
+			size--;
+			continue;
+		}
 		if (!usb_configuration) break;
 		if (!rx_packet) {
 			rx:
-			rx_packet = usb_rx(CDC_RX_ENDPOINT);
-			if (!rx_packet) break;
+			if (!rx_next()) {
+				if (line_bytes() > 0) continue;
+				break;
+			}
 			if (rx_packet->len == 0) {
 				usb_free(rx_packet);
+				rx_packet = NULL;
 				goto rx;
 			}
 		}
@@ -130,6 +276,10 @@ void usb_serial_flush_input(void)
 	usb_packet_t *rx;
 
 	if (!usb_configuration) return;
+	__disable_irq();
+	line_tail = line_head;
+	line_count = 0;
+	__enable_irq();
 	if (rx_packet) {
 		usb_free(rx_packet);
 		rx_packet = NULL;
@@ -141,8 +291,18 @@ void usb_serial_flush_input(void)
 	}
 }
 
-// Maximum number of transmit packets to queue so we don't starve other endpoints for memory
-#define TX_PACKET_LIMIT 8
+// TX_PACKET_LIMIT, the maximum number of transmit packets to queue, is in usb_desc.h
+
+// keep buffers for both receive descriptors, the packet being filled and one spare
+#if TX_PACKET_LIMIT + 4 > NUM_USB_BUFFERS
+#error "TX_PACKET_LIMIT must be at least 4 below NUM_USB_BUFFERS"
+#endif
+
+// full speed bulk endpoints, the packet buffers of usb_mem.h hold 64 bytes
+#if (CDC_RX_SIZE != 8 && CDC_RX_SIZE != 16 && CDC_RX_SIZE != 32 && CDC_RX_SIZE != 64) || \
+    (CDC_TX_SIZE != 8 && CDC_TX_SIZE != 16 && CDC_TX_SIZE != 32 && CDC_TX_SIZE != 64)
+#error "CDC_RX_SIZE and CDC_TX_SIZE must be 8, 16, 32 or 64"
+#endif
 
 // When the PC isn't listening, how long do we wait before discarding data?  If this is
 // too short, we risk losing data during the stalls that are common with ordinary desktop
@@ -173,6 +333,9 @@ void usb_serial_flush_input(void)
   #define TX_TIMEOUT (TX_TIMEOUT_MSEC * 262)
 #endif
 
+// TX_TIMEOUT counts wait loops calibrated at F_CPU, scale it with the core clock divider
+#define TX_WAIT_LIMIT (TX_TIMEOUT / (F_CPU / F_CPU_ACTUAL))
+
 // When we've suffered the transmit timeout, don't wait again until the computer
 // begins accepting data.  If no software is running to receive, we'll just discard
 // data as rapidly as Serial.print() can generate it, until there's something to
@@ -187,36 +350,47 @@ int usb_serial_putchar(uint8_t c)
 }
 
 
+// wait for a transmit packet, with tx_noautoflush set; returns 0 when the
+// host is gone or the transmit timeout hit
+static int tx_packet_wait(void)
+{
+	uint32_t wait_count;
+
+	if (!tx_packet) {
+		wait_count = 0;
+		while (1) {
+			if (!usb_configuration) {
+				tx_noautoflush = 0;
+				return 0;
+			}
+			if (usb_tx_packet_count(CDC_TX_ENDPOINT) < TX_PACKET_LIMIT) {
+				tx_noautoflush = 1;
+				tx_packet = usb_malloc();
+				if (tx_packet) break;
+				tx_noautoflush = 0;
+			}
+			if (++wait_count > TX_WAIT_LIMIT || transmit_previous_timeout) {
+				if (!transmit_previous_timeout) usb_stats.tx_timeouts++;
+				transmit_previous_timeout = 1;
+				return 0;
+			}
+			usb_stats.tx_waits++;
+			yield();
+		}
+	}
+	transmit_previous_timeout = 0;
+	return 1;
+}
+
 int usb_serial_write(const void *buffer, uint32_t size)
 {
 	uint32_t len;
-	uint32_t wait_count;
 	const uint8_t *src = (const uint8_t *)buffer;
 	uint8_t *dest;
 
 	tx_noautoflush = 1;
 	while (size > 0) {
-		if (!tx_packet) {
-			wait_count = 0;
-			while (1) {
-				if (!usb_configuration) {
-					tx_noautoflush = 0;
-					return -1;
-				}
-				if (usb_tx_packet_count(CDC_TX_ENDPOINT) < TX_PACKET_LIMIT) {
-					tx_noautoflush = 1;
-					tx_packet = usb_malloc();
-					if (tx_packet) break;
-					tx_noautoflush = 0;
-				}
-				if (++wait_count > TX_TIMEOUT || transmit_previous_timeout) {
-					transmit_previous_timeout = 1;
-					return -1;
-				}
-				yield();
-			}
-		}
-		transmit_previous_timeout = 0;
+		if (!tx_packet_wait()) return -1;
 		len = CDC_TX_SIZE - tx_packet->index;
 		if (len > size) len = size;
 		dest = tx_packet->buf + tx_packet->index;
@@ -227,13 +401,47 @@ int usb_serial_write(const void *buffer, uint32_t size)
 			tx_packet->len = CDC_TX_SIZE;
 			usb_tx(CDC_TX_ENDPOINT, tx_packet);
 			tx_packet = NULL;
+			tx_zlp_needed = 1;
 		}
-		usb_cdc_transmit_flush_timer = TRANSMIT_FLUSH_TIMEOUT;
+		usb_cdc_transmit_flush_timer = transmit_flush_timeout;
 	}
 	tx_noautoflush = 0;
 	return 0;
 }
 
+// Zero-copy transmit: usb_serial_write_reserve() returns the free space of the
+// current transmit packet (at least 1 byte) and where it starts, the caller
+// encodes into it and passes the number of bytes written to
+// usb_serial_write_commit(). A full packet is sent, the next reserve starts a
+// new one. Returns 0 if the host is gone or not reading, like
+// usb_serial_write() returning -1. Every reserve must be followed by a commit,
+// the automatic flush is held off in between.
+uint32_t usb_serial_write_reserve(uint8_t **buffer)
+{
+	tx_noautoflush = 1;
+	if (!tx_packet_wait()) {
+		tx_noautoflush = 0;
+		return 0;
+	}
+	*buffer = tx_packet->buf + tx_packet->index;
+	return CDC_TX_SIZE - tx_packet->index;
+}
+
+void usb_serial_write_commit(uint32_t size)
+{
+	if (tx_packet) {
+		tx_packet->index += size;
+		if (tx_packet->index >= CDC_TX_SIZE) {
+			tx_packet->len = CDC_TX_SIZE;
+			usb_tx(CDC_TX_ENDPOINT, tx_packet);
+			tx_packet = NULL;
+			tx_zlp_needed = 1;
+		}
+		usb_cdc_transmit_flush_timer = transmit_flush_timeout;
+	}
+	tx_noautoflush = 0;
+}
+
 int usb_serial_write_buffer_free(void)
 {
 	uint32_t len;
@@ -259,42 +467,59 @@ int usb_serial_write_buffer_free(void)
 	return len;
 }
 
-void usb_serial_flush_output(void)
+// send what is buffered: the partial packet, or a zero length packet if the
+// last one sent was full and the host would otherwise wait for more
+static void tx_flush(void)
 {
-	if (!usb_configuration) return;
-	tx_noautoflush = 1;
 	if (tx_packet) {
-		usb_cdc_transmit_flush_timer = 0;
 		tx_packet->len = tx_packet->index;
 		usb_tx(CDC_TX_ENDPOINT, tx_packet);
 		tx_packet = NULL;
-	} else {
+	} else if (tx_zlp_needed) {
 		usb_packet_t *tx = usb_malloc();
-		if (tx) {
-			usb_cdc_transmit_flush_timer = 0;
-			usb_tx(CDC_TX_ENDPOINT, tx);
-		} else {
+		if (!tx) {
 			usb_cdc_transmit_flush_timer = 1;
+			return;
 		}
+		usb_stats.tx_zlps++;
+		usb_tx(CDC_TX_ENDPOINT, tx);
 	}
+	tx_zlp_needed = 0;
+	usb_cdc_transmit_flush_timer = 0;
+}
+
+void usb_serial_flush_output(void)
+{
+	if (!usb_configuration) return;
+	tx_noautoflush = 1;
+	tx_flush();
 	tx_noautoflush = 0;
 }
 
+// the end of a reply: everything written so far goes out with this one flush,
+// nothing is left for the SOF timer
+void usb_serial_end_response(void)
+{
+	usb_serial_flush_output();
+}
+
+// milliseconds of idle output before the SOF interrupt flushes a partial
+// packet, 0 waits for a full packet or the next flush / end of response
+void usb_serial_set_flush_timeout(uint8_t ms)
+{
+	transmit_flush_timeout = ms;
+	if (!ms) usb_cdc_transmit_flush_timer = 0;
+}
+
+uint8_t usb_serial_get_flush_timeout(void)
+{
+	return transmit_flush_timeout;
+}
+
 void usb_serial_flush_callback(void)
 {
 	if (tx_noautoflush) return;
-	if (tx_packet) {
-		tx_packet->len = tx_packet->index;
-		usb_tx(CDC_TX_ENDPOINT, tx_packet);
-		tx_packet = NULL;
-	} else {
-		usb_packet_t *tx = usb_malloc();
-		if (tx) {
-			usb_tx(CDC_TX_ENDPOINT, tx);
-		} else {
-			usb_cdc_transmit_flush_timer = 1;
-		}
-	}
+	tx_flush();
 }
 
 
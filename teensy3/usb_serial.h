@@ -48,10 +48,17 @@ int usb_serial_peekchar(void);
 int usb_serial_available(void);
 int usb_serial_read(void *buffer, uint32_t size);
 void usb_serial_flush_input(void);
+int usb_serial_readline(char *buffer, uint32_t size);
+#define USB_SERIAL_LINE_TOO_LONG	-2
 int usb_serial_putchar(uint8_t c);
 int usb_serial_write(const void *buffer, uint32_t size);
 int usb_serial_write_buffer_free(void);
+uint32_t usb_serial_write_reserve(uint8_t **buffer);
+void usb_serial_write_commit(uint32_t size);
 void usb_serial_flush_output(void);
+void usb_serial_end_response(void);
+void usb_serial_set_flush_timeout(uint8_t ms);
+uint8_t usb_serial_get_flush_timeout(void);
 extern uint32_t usb_cdc_line_coding[2];
 extern volatile uint32_t usb_cdc_line_rtsdtr_millis;
 extern volatile uint32_t systick_millis_count;
@@ -87,6 +94,9 @@ public:
 	int availableForWrite() { return usb_serial_write_buffer_free(); }
 	using Print::write;
         void send_now(void) { usb_serial_flush_output(); }
+        void endResponse(void) { usb_serial_end_response(); }
+        void setFlushTimeout(uint8_t ms) { usb_serial_set_flush_timeout(ms); }
+        uint8_t flushTimeout(void) { return usb_serial_get_flush_timeout(); }
         uint32_t baud(void) { return usb_cdc_line_coding[0]; }
         uint8_t stopbits(void) { uint8_t b = usb_cdc_line_coding[1]; if (!b) b = 1; return b; }
         uint8_t paritytype(void) { return usb_cdc_line_coding[1] >> 8; } // 0=none, 1=odd, 2=even
@@ -107,6 +117,8 @@ public:
 		setReadError();
 		return count;
 	}
+	// copy one complete '\r' terminated line, -1 if none is complete yet
+	int readLine(char *buffer, size_t size) { return usb_serial_readline(buffer, size); }
 
 };
 extern usb_serial_class Serial;